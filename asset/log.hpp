@@ -3,28 +3,50 @@
 #define BASE_LOG_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
 #include <chrono>
+#include <climits>
 #include <cinttypes>
+#include <cmath>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <deque>
 #include <exception>
+#include <fcntl.h>
 #include <format>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <ostream>
+#include <ranges>
 #include <source_location>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <thread>
+#include <type_traits>
 #include <unistd.h>
+#include <variant>
 #include <vector>
 
+#include "reflect.hpp"
+
 //! Define log levels
 #define LOG_LEVEL_FATAL 0  //!< Program will crash
 #define LOG_LEVEL_ERROR 1  //!< Got serious problem, program can't handle
@@ -40,32 +62,334 @@
 #define LOG_MODULE_ID NULL
 #endif // LOG_MODULE_ID
 
+//! 编译期最低日志等级, 低于该等级 (数值更大) 的日志调用连同参数求值一起被去掉
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif // LOG_COMPILE_LEVEL
+
 //! Define commonly macros
-#define LogPrintf(level, fmt, ...) \
+//! 先判断编译期等级和模块的运行期等级 (一次 relaxed load), 通过后才做格式化
+#define LOG_LEVEL_ENABLED(level) \
+	((level) <= LOG_COMPILE_LEVEL && (level) <= _log_module_level().load(std::memory_order_relaxed))
+#define LogPrintf(level, fmt, ...) (LOG_LEVEL_ENABLED(level) ? LOG_PRINTF_CALL(level, fmt, ##__VA_ARGS__) : void())
+
+//! 定义 LOG_BINARY_MODE 后 LogPrintf 走二进制延迟格式化, 见 LogBinary_Enable; fmt 需要是字符串字面量
+#ifdef LOG_BINARY_MODE
+#define LOG_PRINTF_CALL(level, fmt, ...) LogBinaryPrintf(level, fmt, ##__VA_ARGS__)
+#else
+#define LOG_PRINTF_CALL(level, fmt, ...) \
 	LogPrintfFunc(LOG_MODULE_ID, level, std::source_location::current(), fmt, ##__VA_ARGS__)
+#endif
 
-#define LogFatal(fmt, ...)  LogPrintf(LOG_LEVEL_FATAL, fmt, ##__VA_ARGS__)
-#define LogErr(fmt, ...)    LogPrintf(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
-#define LogWarn(fmt, ...)   LogPrintf(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+//! 二进制模式的调用点: 首次执行时注册格式串和位置, 之后只写入参数字节; 未开启二进制模式时退回 LogPrintfFunc
+#define LogBinaryPrintf(level, fmt, ...)                                                        \
+	[&](const std::source_location _log_location) {                                            \
+		if (log_binary::enabled()) {                                                             \
+			static const uint32_t _log_site = log_binary::register_site(                         \
+			    LOG_MODULE_ID, level, _log_location, fmt,                                        \
+			    log_binary::arg_tags<decltype(log_binary::deduce(__VA_ARGS__))>::value);           \
+			if (log_binary::write(_log_site, ##__VA_ARGS__)) {                                   \
+				return;                                                                          \
+			}                                                                                    \
+		}                                                                                        \
+		LogPrintfFunc(LOG_MODULE_ID, level, _log_location, fmt, ##__VA_ARGS__);                  \
+	}(std::source_location::current())
+
+#define LOG_DISCARD() ((void)0)
+#define LogFatal(fmt, ...) LogPrintf(LOG_LEVEL_FATAL, fmt, ##__VA_ARGS__)
+#define LogErr(fmt, ...)   LogPrintf(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LogWarn(fmt, ...) LogPrintf(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LogWarn(fmt, ...) LOG_DISCARD()
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_NOTICE
 #define LogNotice(fmt, ...) LogPrintf(LOG_LEVEL_NOTICE, fmt, ##__VA_ARGS__)
-#define LogInfo(fmt, ...)   LogPrintf(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
-#define LogDbg(fmt, ...)    LogPrintf(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
-#define LogTrace(fmt, ...)  LogPrintf(LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
-#define LogTag() LogPrintf(LOG_LEVEL_TRACE, "==> Run Here <==")
-#define LogUndo() LogPrintf(LOG_LEVEL_NOTICE, "!!! Undo !!!")
+#else
+#define LogNotice(fmt, ...) LOG_DISCARD()
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LogInfo(fmt, ...) LogPrintf(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LogInfo(fmt, ...) LOG_DISCARD()
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LogDbg(fmt, ...) LogPrintf(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LogDbg(fmt, ...) LOG_DISCARD()
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+#define LogTrace(fmt, ...) LogPrintf(LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+#else
+#define LogTrace(fmt, ...) LOG_DISCARD()
+#endif
+#define LogTag()  LogTrace("==> Run Here <==")
+#define LogUndo() LogNotice("!!! Undo !!!")
 
 //! 打印错误码，需要 #include <string.h>
 #define LogErrno(err, fmt, ...) LogErr("Errno:{}({}) " fmt, (err), strerror(err), ##__VA_ARGS__)
 
+//! 以 JSON 对象输出聚合类 obj 的字段名和值, 见 LogStructFunc
+#define LogStruct(level, obj) (LOG_LEVEL_ENABLED(level) ? LOG_STRUCT_CALL(level, obj) : void())
+#ifdef LOG_BINARY_MODE
+#define LOG_STRUCT_CALL(level, obj) LogBinaryStruct(level, obj)
+#else
+#define LOG_STRUCT_CALL(level, obj) LogStructFunc(LOG_MODULE_ID, level, std::source_location::current(), obj)
+#endif
+//! 二进制模式的 LogStruct: 成员都是标量或字符串时按一条二进制记录写入, 否则退回 LogStructFunc
+#define LogBinaryStruct(level, obj)                                                                         \
+	[&](const std::source_location _log_location, const auto& _log_obj) {                                   \
+		using _LogType = std::remove_cvref_t<decltype(_log_obj)>;                                           \
+		if constexpr (log_struct::binary_v<_LogType>) {                                                     \
+			if (log_binary::enabled()) {                                                                    \
+				static const uint32_t _log_site = log_binary::register_site(                                \
+				    LOG_MODULE_ID, level, _log_location, log_struct::binary_format<_LogType>::chars.data(), \
+				    log_binary::arg_tags<typename log_struct::binary_layout<_LogType>::types>::value);      \
+				if (reflect::visit_members(_log_obj, [](const auto&... _log_members) {                      \
+					    return log_binary::write(_log_site, _log_members...);                               \
+				    })) {                                                                                   \
+					return;                                                                                 \
+				}                                                                                           \
+			}                                                                                               \
+		}                                                                                                   \
+		LogStructFunc(LOG_MODULE_ID, level, _log_location, _log_obj);                                       \
+	}(std::source_location::current(), obj)
+
+//! 按调用点限流: 每个调用点一个静态状态, 被限流时只有一两次 relaxed 原子操作;
+//! 恢复输出时先打印一条被丢弃的条数, LogFirstN 不会恢复输出, 丢弃条数每到 2 的幂时打印一次
+#define LOG_LIMITED_PRINTF(limiter, check, level, fmt, ...)                                 \
+	do {                                                                                    \
+		if (LOG_LEVEL_ENABLED(level)) {                                                     \
+			static constinit limiter _log_limiter;                                          \
+			if (_log_limiter.check) {                                                       \
+				if (const uint64_t _log_suppressed = _log_limiter.take_suppressed()) {      \
+					LOG_PRINTF_CALL(level, "{} messages suppressed here", _log_suppressed); \
+				}                                                                           \
+				LOG_PRINTF_CALL(level, fmt, ##__VA_ARGS__);                                 \
+			} else if (const uint64_t _log_dropped = _log_limiter.take_milestone()) {       \
+				LOG_PRINTF_CALL(level, "{} messages suppressed here so far", _log_dropped); \
+			}                                                                               \
+		}                                                                                   \
+	} while (0)
+//! 只输出前 n 次
+#define LogFirstN(level, n, fmt, ...) LOG_LIMITED_PRINTF(log_limit::FirstN, pass(n), level, fmt, ##__VA_ARGS__)
+//! 每 n 次输出一次 (第 1, n+1, 2n+1 ... 次)
+#define LogEveryN(level, n, fmt, ...) LOG_LIMITED_PRINTF(log_limit::EveryN, pass(n), level, fmt, ##__VA_ARGS__)
+//! 每 ms 毫秒最多输出一次
+#define LogEveryMs(level, ms, fmt, ...) LOG_LIMITED_PRINTF(log_limit::EveryMs, pass(ms), level, fmt, ##__VA_ARGS__)
+//! 令牌桶: 平均每秒 per_second 条, 最多连续 burst 条
+#define LogRateLimited(level, per_second, burst, fmt, ...) \
+	LOG_LIMITED_PRINTF(log_limit::TokenBucket, pass(per_second, burst), level, fmt, ##__VA_ARGS__)
+
+//! 日志时间戳使用的时钟
+using LogClock = std::chrono::system_clock;
+
 struct LogContent {
 	const std::thread::id thread_id; //!< 线程ID
-	const std::string timestamp;
+	const LogClock::time_point timestamp; //!< 原始时钟值, 由输出端调用 log_format_timestamp 按需格式化
 	const std::string module_id; //!< 模块名
 	const std::source_location location;
 	const int level; //!< 日志等级
 	const std::string text;
 };
 
+/**
+ * @brief 获取模块的运行期日志等级, 所有编译单元共享同一份
+ * 首次访问时创建, 默认 LOG_LEVEL_TRACE (全部输出); 返回的引用在程序运行期间一直有效
+ *
+ * @param module_id 模块名, nullptr 视为 "???"
+ * @return std::atomic<int>&
+ */
+inline std::atomic<int>& log_module_level(const char* module_id) {
+	static std::mutex mtx;
+	static std::map<std::string, std::atomic<int>, std::less<>> levels;
+	const std::string_view name = (module_id != nullptr) ? module_id : "???";
+	std::unique_lock<std::mutex> _lock(mtx);
+	auto iter = levels.find(name);
+	if (iter == levels.end()) {
+		iter = levels.try_emplace(std::string(name), LOG_LEVEL_TRACE).first;
+	}
+	return iter->second;
+}
+/**
+ * @brief 设置模块的运行期日志等级, 等级数值大于 level 的日志直接丢弃
+ */
+inline void LogSetModuleLevel(const char* module_id, int level) {
+	log_module_level(module_id).store(level, std::memory_order_relaxed);
+}
+inline int LogGetModuleLevel(const char* module_id) {
+	return log_module_level(module_id).load(std::memory_order_relaxed);
+}
+namespace {
+	/**
+	 * @brief 本编译单元 LOG_MODULE_ID 对应的运行期等级, 供 LogPrintf 宏读取
+	 * 用函数内 static 在首次调用时解析, 其他编译单元的静态初始化中打日志也不受初始化顺序影响
+	 */
+	inline std::atomic<int>& _log_module_level() {
+		static std::atomic<int>& level = log_module_level(LOG_MODULE_ID);
+		return level;
+	}
+} // namespace
+
+/**
+ * @brief LogFirstN / LogEveryN / LogEveryMs / LogRateLimited 的调用点状态
+ * 都可以常量初始化, 作为函数内 static 时没有初始化守卫
+ */
+namespace log_limit {
+	inline int64_t now_ns() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+		    .count();
+	}
+
+	//! 被限流的条数, 恢复输出的线程取走并清零
+	class Suppressed {
+	public:
+		//! 记一条被丢弃的日志, 返回上次取走之后的累计条数
+		uint64_t add() { return _count.fetch_add(1, std::memory_order_relaxed) + 1; }
+		uint64_t take_suppressed() {
+			return (_count.load(std::memory_order_relaxed) != 0) ? _count.exchange(0, std::memory_order_relaxed) : 0;
+		}
+		//! 被限流时是否需要单独报告丢弃条数, 只有不会恢复输出的 FirstN 需要
+		uint64_t take_milestone() { return 0; }
+
+	private:
+		std::atomic<uint64_t> _count{0};
+	};
+
+	class FirstN : public Suppressed {
+	public:
+		bool pass(uint64_t n) {
+			if (_count.load(std::memory_order_relaxed) < n && _count.fetch_add(1, std::memory_order_relaxed) < n) {
+				return true;
+			}
+			//! 不会恢复输出, 丢弃条数每到 2 的幂时由 take_milestone 单独报告一次
+			if (const uint64_t dropped = add(); std::has_single_bit(dropped)) {
+				_milestone.store(dropped, std::memory_order_relaxed);
+			}
+			return false;
+		}
+		uint64_t take_suppressed() { return 0; }
+		uint64_t take_milestone() {
+			return (_milestone.load(std::memory_order_relaxed) != 0) ? _milestone.exchange(0, std::memory_order_relaxed) : 0;
+		}
+
+	private:
+		std::atomic<uint64_t> _count{0};
+		std::atomic<uint64_t> _milestone{0};
+	};
+
+	class EveryN : public Suppressed {
+	public:
+		bool pass(uint64_t n) {
+			if (n <= 1 || _count.fetch_add(1, std::memory_order_relaxed) % n == 0) {
+				return true;
+			}
+			add();
+			return false;
+		}
+
+	private:
+		std::atomic<uint64_t> _count{0};
+	};
+
+	class EveryMs : public Suppressed {
+	public:
+		bool pass(int64_t ms) {
+			const int64_t now = now_ns();
+			//! ms 很大时饱和到 INT64_MAX, 不溢出成负数
+			const int64_t period = (ms <= 0) ? 0 : (ms < INT64_MAX / 1000000) ? ms * 1000000 : INT64_MAX;
+			const int64_t until = (period > INT64_MAX - now) ? INT64_MAX : now + period;
+			int64_t next = _next.load(std::memory_order_relaxed);
+			if (now >= next && _next.compare_exchange_strong(next, until, std::memory_order_relaxed)) {
+				return true;
+			}
+			add();
+			return false;
+		}
+
+	private:
+		std::atomic<int64_t> _next{INT64_MIN};
+	};
+
+	/**
+	 * @brief 令牌桶, 用 GCRA (理论到达时间) 实现, 只需要一个原子变量
+	 * 每条消息把理论到达时间推后 1/per_second 秒, 超前当前时间不超过 burst 条的间隔时放行;
+	 * per_second 不是正数 (含 NaN) 时全部丢弃, burst 限制在 1 ~ 2^20 之间;
+	 * 速率限制在每秒 min_rate ~ 1e9 条之间, min_rate 保证 interval * burst 不超出 int64 纳秒
+	 */
+	class TokenBucket : public Suppressed {
+	public:
+		//! 最低速率每秒 1e-3 条 (约 17 分钟 1 条): interval 1e12 ns 乘以最大 burst 2^20 约 1.05e18, 加上 steady_clock 的当前值仍在 int64 内
+		static constexpr double min_rate = 1e-3;
+		static constexpr uint64_t max_burst = 1 << 20;
+
+		bool pass(double per_second, uint64_t burst) {
+			if (!(per_second > 0)) {
+				add();
+				return false;
+			}
+			const auto interval = static_cast<int64_t>(1e9 / std::clamp(per_second, min_rate, 1e9));
+			const int64_t now = now_ns();
+			const int64_t limit = now + interval * static_cast<int64_t>(std::clamp<uint64_t>(burst, 1, max_burst));
+			int64_t tat = _tat.load(std::memory_order_relaxed);
+			for (;;) {
+				const int64_t next = std::max(tat, now) + interval;
+				if (next > limit) {
+					add();
+					return false;
+				}
+				if (_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+					return true;
+				}
+			}
+		}
+
+	private:
+		std::atomic<int64_t> _tat{INT64_MIN};
+	};
+} // namespace log_limit
+
+/**
+ * @brief 格式化时间戳, 形如 "2026-10-18 12:34:56.123456789 CST"
+ * 每个线程缓存精确到秒的前缀和时区名, 同一秒内只重新计算纳秒部分;
+ * 返回的 string_view 在本线程下一次调用前有效
+ *
+ * @param timestamp LogContent::timestamp
+ * @return std::string_view
+ */
+inline std::string_view log_format_timestamp(LogClock::time_point timestamp) {
+	struct Cache {
+		int64_t second = INT64_MIN;
+		size_t prefix_len = 0;
+		size_t zone_len = 0;
+		char zone[16];
+		char buf[64];
+	};
+	thread_local Cache cache;
+	const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+	int64_t second = ns / 1000000000;
+	int64_t sub = ns % 1000000000;
+	if (sub < 0) {
+		second--;
+		sub += 1000000000;
+	}
+	if (second != cache.second) {
+		const time_t t = static_cast<time_t>(second);
+		struct tm tm {};
+		localtime_r(&t, &tm);
+		cache.prefix_len = strftime(cache.buf, sizeof(cache.buf) - 32, "%F %T.", &tm);
+		cache.zone_len = strftime(cache.zone, sizeof(cache.zone), " %Z", &tm);
+		cache.second = second;
+	}
+	char* p = cache.buf + cache.prefix_len;
+	for (int i = 8; i >= 0; i--) {
+		p[i] = static_cast<char>('0' + sub % 10);
+		sub /= 10;
+	}
+	memcpy(p + 9, cache.zone, cache.zone_len);
+	return {cache.buf, cache.prefix_len + 9 + cache.zone_len};
+}
+
 //! 定义日志输出函数
 using LogPrintfFuncType = void (*)(const LogContent* content, void* ptr);
 
@@ -78,7 +402,68 @@ namespace {
 		LogPrintfFuncType func;
 		void* ptr;
 	};
-	std::vector<OutputChannel> _output_channels;
+	/**
+	 * @brief 回调列表的不可变快照, 增删回调时复制一份新的再原子替换 (copy-on-write)
+	 * 读者不加锁, 通过 hazard pointer 保护正在使用的快照; 为空时 _output_channels 为 nullptr
+	 */
+	using ChannelList = std::vector<OutputChannel>;
+	std::atomic<const ChannelList*> _output_channels{nullptr};
+	//! 已被替换但可能仍有读者在用的快照, 由 _mtx 保护
+	std::vector<const ChannelList*> _retired_channels;
+
+	constexpr size_t LOG_HAZARD_SLOTS = 128;
+	struct alignas(64) HazardSlot {
+		std::atomic<const ChannelList*> ptr{nullptr};
+		std::atomic<bool> used{false};
+	};
+	HazardSlot _hazard_slots[LOG_HAZARD_SLOTS];
+
+	/**
+	 * @brief 当前线程占用的 hazard 槽位, 线程退出时归还; 槽位用完时返回 nullptr
+	 */
+	HazardSlot* hazard_slot() {
+		struct Holder {
+			HazardSlot* slot = nullptr;
+			Holder() {
+				for (auto& item : _hazard_slots) {
+					bool expected = false;
+					if (item.used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+						slot = &item;
+						break;
+					}
+				}
+			}
+			~Holder() {
+				if (slot != nullptr) {
+					slot->ptr.store(nullptr, std::memory_order_release);
+					slot->used.store(false, std::memory_order_release);
+				}
+			}
+		};
+		thread_local Holder holder;
+		return holder.slot;
+	}
+	//! 当前线程 dispatch 的嵌套深度, 回调里再打印日志时沿用外层已保护的快照
+	thread_local uint32_t _dispatch_depth = 0;
+
+	/**
+	 * @brief 发布新的快照并回收没有读者的旧快照, 调用方需持有 _mtx
+	 */
+	void publish_channels(const ChannelList* list) {
+		const ChannelList* old = _output_channels.exchange(list, std::memory_order_seq_cst);
+		if (old != nullptr) {
+			_retired_channels.push_back(old);
+		}
+		std::erase_if(_retired_channels, [](const ChannelList* retired) {
+			for (const auto& item : _hazard_slots) {
+				if (item.ptr.load(std::memory_order_seq_cst) == retired) {
+					return false;
+				}
+			}
+			delete retired;
+			return true;
+		});
+	}
 
 	/**
 	 * @brief 判断是否需要dispatch，_output_channels不为空则需要;
@@ -86,36 +471,351 @@ namespace {
 	 * @return true
 	 * @return false
 	 */
-	bool can_dispatch() {
-		std::unique_lock<std::mutex> _lock(_mtx);
-		return !_output_channels.empty();
-	}
+	bool can_dispatch() { return _output_channels.load(std::memory_order_relaxed) != nullptr; }
 	/**
 	 * @brief
 	 * 将content分配到注册的output_channels中，并调用output_channels中的回调函数
+	 * 读取快照不加锁, 回调可能在多个线程上并发执行
 	 *
 	 * @param content
 	 */
 	void dispatch(const LogContent& content) {
-		std::unique_lock<std::mutex> _lock(_mtx);
-		for (const auto& item : _output_channels) {
-			if (item.func) {
-				item.func(&content, item.ptr);
+		auto run = [&content](const ChannelList* list) {
+			if (list == nullptr) {
+				return;
+			}
+			for (const auto& item : *list) {
+				if (item.func) {
+					item.func(&content, item.ptr);
+				}
+			}
+		};
+		HazardSlot* slot = hazard_slot();
+		if (slot == nullptr) {
+			//! 槽位用完的线程退回加锁读取: 回收旧快照同样需要持有 _mtx, 在锁内复制回调列表, 解锁后再调用,
+			//! 回调里增删回调或再打印日志不会死锁
+			ChannelList copy;
+			{
+				std::unique_lock<std::mutex> _lock(_mtx);
+				if (const ChannelList* list = _output_channels.load(std::memory_order_acquire)) {
+					copy = *list;
+				}
 			}
+			run(&copy);
+			return;
 		}
+		if (_dispatch_depth > 0) {
+			run(slot->ptr.load(std::memory_order_relaxed));
+			return;
+		}
+		const ChannelList* list = _output_channels.load(std::memory_order_acquire);
+		for (;;) {
+			slot->ptr.store(list, std::memory_order_seq_cst);
+			const ChannelList* again = _output_channels.load(std::memory_order_seq_cst);
+			if (again == list) {
+				break;
+			}
+			list = again;
+		}
+		_dispatch_depth++;
+		run(list);
+		_dispatch_depth--;
+		slot->ptr.store(nullptr, std::memory_order_release);
+	}
+} // namespace
+
+//! 异步模式下队列满时的处理方式
+enum class LogOverflowPolicy {
+	Block,        //!< 等待消费者腾出空间
+	Drop,         //!< 直接丢弃
+	DropAndCount, //!< 丢弃并计数, 消费者恢复后输出一条丢弃数量的告警
+};
+
+/**
+ * @brief 有界无锁 MPSC 环形队列 (Vyukov), 每个槽位用序号标记是否可写/可读
+ * 多个生产者通过 CAS 抢占写入位置, 唯一的消费者线程顺序读出
+ */
+class LogRingBuffer {
+public:
+	explicit LogRingBuffer(size_t capacity) {
+		size_t cap = 2;
+		while (cap < capacity) {
+			cap <<= 1;
+		}
+		_mask = cap - 1;
+		_cells = std::make_unique<Cell[]>(cap);
+		for (size_t i = 0; i < cap; i++) {
+			_cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+	LogRingBuffer(const LogRingBuffer&) = delete;
+	LogRingBuffer& operator=(const LogRingBuffer&) = delete;
+
+	/**
+	 * @brief 生产者写入, 队列满时返回 false
+	 * @param position 非空时写入本条的序号 (从 0 开始), 供调用方按积压量决定是否唤醒消费者
+	 */
+	bool try_push(const LogContent& content, size_t* position = nullptr) {
+		return try_push(content.thread_id, content.timestamp, content.module_id, content.location, content.level, content.text,
+		                position);
+	}
+	/**
+	 * @brief 按字段写入, 字符串直接从调用方的缓冲区拷进槽位, 不需要先构造 LogContent
+	 */
+	bool try_push(std::thread::id thread_id, LogClock::time_point timestamp, std::string_view module_id,
+	              const std::source_location& location, int level, std::string_view text, size_t* position = nullptr) {
+		size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &_cells[pos & _mask];
+			const size_t seq = cell->seq.load(std::memory_order_acquire);
+			const auto dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (dif == 0) {
+				if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (dif < 0) {
+				return false;
+			} else {
+				pos = _enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+		//! 槽位自带字符串, 复用其容量保存 module_id 和 text, 生产者不分配内存
+		cell->thread_id = thread_id;
+		cell->timestamp = timestamp;
+		cell->module_id.assign(module_id);
+		cell->location = location;
+		cell->level = level;
+		cell->text.assign(text);
+		cell->seq.store(pos + 1, std::memory_order_release);
+		if (position != nullptr) {
+			*position = pos;
+		}
+		return true;
+	}
+	/**
+	 * @brief 消费者读出一条并调用 func, 队列空时返回 false; 只能由一个线程调用
+	 */
+	template <typename Func>
+	bool try_pop(Func&& func) {
+		Cell& cell = _cells[_dequeue_pos & _mask];
+		if (cell.seq.load(std::memory_order_acquire) != _dequeue_pos + 1) {
+			return false;
+		}
+		const LogContent content = {.thread_id = cell.thread_id,
+		                            .timestamp = cell.timestamp,
+		                            .module_id = cell.module_id,
+		                            .location = cell.location,
+		                            .level = cell.level,
+		                            .text = cell.text};
+		func(content);
+		cell.seq.store(_dequeue_pos + _mask + 1, std::memory_order_release);
+		_dequeue_pos++;
+		return true;
+	}
+	bool empty() const { return _cells[_dequeue_pos & _mask].seq.load(std::memory_order_acquire) != _dequeue_pos + 1; }
+	size_t capacity() const { return _mask + 1; }
+
+private:
+	struct Cell {
+		std::atomic<size_t> seq;
+		std::thread::id thread_id;
+		LogClock::time_point timestamp;
+		std::string module_id;
+		std::source_location location;
+		int level = 0;
+		std::string text;
+	};
+	std::unique_ptr<Cell[]> _cells;
+	size_t _mask;
+	alignas(64) std::atomic<size_t> _enqueue_pos{0};
+	alignas(64) size_t _dequeue_pos = 0;
+};
+
+namespace {
+	struct AsyncState {
+		LogRingBuffer queue;
+		LogOverflowPolicy policy;
+		std::atomic<bool> stop{false};
+		std::atomic<bool> sleeping{false};
+		std::atomic<uint32_t> signal{0};
+		std::atomic<uint64_t> dropped{0};
+		std::thread consumer;
+
+		AsyncState(size_t capacity, LogOverflowPolicy policy) : queue(capacity), policy(policy) {}
+	};
+	std::atomic<AsyncState*> _async{nullptr};
+
+	void async_wake(AsyncState& state) {
+		// 与 async_consume 中的 fence 配对: 要么消费者看到新数据, 要么这里看到 sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (state.sleeping.load(std::memory_order_relaxed)) {
+			state.signal.fetch_add(1, std::memory_order_relaxed);
+			state.signal.notify_one();
+		}
+	}
+
+	void async_consume(AsyncState& state) {
+		uint64_t reported = 0;
+		for (;;) {
+			while (state.queue.try_pop([](const LogContent& content) { dispatch(content); })) {
+			}
+			if (state.policy == LogOverflowPolicy::DropAndCount) {
+				const uint64_t dropped = state.dropped.load(std::memory_order_relaxed);
+				if (dropped != reported) {
+					const LogContent content = {.thread_id = std::this_thread::get_id(),
+					                            .timestamp = LogClock::now(),
+					                            .module_id = "log",
+					                            .location = std::source_location::current(),
+					                            .level = LOG_LEVEL_WARN,
+					                            .text = std::format("{} log records dropped, async queue is full", dropped - reported)};
+					dispatch(content);
+					reported = dropped;
+				}
+			}
+			if (state.stop.load(std::memory_order_acquire) && state.queue.empty()) {
+				return;
+			}
+			const uint32_t signal = state.signal.load(std::memory_order_relaxed);
+			state.sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (state.queue.empty() && !state.stop.load(std::memory_order_relaxed)) {
+				state.signal.wait(signal, std::memory_order_relaxed);
+			}
+			state.sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @brief 异步模式下把一条日志放入队列, 返回 false 表示没有开启异步模式
+	 * 字符串直接拷进队列槽位, LogContent 只在消费者一侧构造
+	 */
+	bool async_push(LogClock::time_point timestamp, std::string_view module_id, const std::source_location& location, int level,
+	                std::string_view text) {
+		AsyncState* state = _async.load(std::memory_order_acquire);
+		if (state == nullptr) {
+			return false;
+		}
+		const std::thread::id thread_id = std::this_thread::get_id();
+		while (!state->queue.try_push(thread_id, timestamp, module_id, location, level, text)) {
+			if (state->policy == LogOverflowPolicy::Block) {
+				async_wake(*state);
+				std::this_thread::yield();
+				continue;
+			}
+			if (state->policy == LogOverflowPolicy::DropAndCount) {
+				state->dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			return true;
+		}
+		async_wake(*state);
+		return true;
+	}
+} // namespace
+
+/**
+ * @brief 开启异步模式: LogPrintfFunc 只把日志放入无锁队列, 由独立的消费者线程调用输出回调
+ * 需要在没有其他线程打印日志时调用
+ *
+ * @param capacity 队列容量, 向上取整到 2 的幂
+ * @param policy   队列满时的处理方式
+ */
+inline void LogAsync_Enable(size_t capacity = 8192, LogOverflowPolicy policy = LogOverflowPolicy::Block) {
+	if (_async.load() != nullptr) {
+		return;
+	}
+	auto* state = new AsyncState(capacity, policy);
+	state->consumer = std::thread(async_consume, std::ref(*state));
+	_async.store(state, std::memory_order_release);
+}
+/**
+ * @brief 关闭异步模式, 输出队列中剩余的日志后返回; 需要在没有其他线程打印日志时调用
+ */
+inline void LogAsync_Disable() {
+	AsyncState* state = _async.exchange(nullptr);
+	if (state == nullptr) {
+		return;
+	}
+	state->stop.store(true, std::memory_order_release);
+	state->signal.fetch_add(1, std::memory_order_relaxed);
+	state->signal.notify_one();
+	state->consumer.join();
+	delete state;
+}
+/**
+ * @brief DropAndCount 策略下累计丢弃的日志条数, 其他策略恒为 0
+ */
+inline uint64_t LogAsync_Dropped() {
+	AsyncState* state = _async.load(std::memory_order_acquire);
+	return state ? state->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+namespace {
+	//! 程序退出时输出异步队列中剩余的日志
+	struct AsyncFlushAtExit {
+		~AsyncFlushAtExit() { LogAsync_Disable(); }
+	} _async_flush_at_exit;
+} // namespace
+
+namespace {
+	/**
+	 * @brief LogPrintfFunc 使用的线程局部格式化缓冲区, 容量跨调用复用
+	 * 格式化时不再逐步扩容; 异步模式下直接从这里拷进队列槽位, 同步模式下 LogContent::text 按最终长度只分配一次;
+	 * 回调中再次打印日志时外层缓冲区仍在使用, 此时改用临时字符串
+	 */
+	class TextBuffer {
+	public:
+		TextBuffer() : _owner(!_busy), _text(_owner ? _tls_text : _nested) {
+			_busy = true;
+			_text.clear();
+		}
+		~TextBuffer() {
+			if (_owner) {
+				_busy = false;
+			}
+		}
+		TextBuffer(const TextBuffer&) = delete;
+		TextBuffer& operator=(const TextBuffer&) = delete;
+		std::string& get() { return _text; }
+
+	private:
+		static inline thread_local std::string _tls_text;
+		static inline thread_local bool _busy = false;
+		const bool _owner;
+		std::string _nested;
+		std::string& _text;
+	};
+
+	/**
+	 * @brief 提交一条已格式化的日志: 异步模式下放入队列, 否则构造 LogContent 直接分发
+	 */
+	void log_submit(const char* module_id, int level, const std::source_location& location, LogClock::time_point timestamp,
+	                std::string_view text) {
+		const char* module = (module_id != nullptr) ? module_id : "???";
+		if (async_push(timestamp, module, location, level, text)) {
+			return;
+		}
+		const LogContent content = {.thread_id = std::this_thread::get_id(),
+		                            .timestamp = timestamp,
+		                            .module_id = module,
+		                            .location = location,
+		                            .level = level,
+		                            .text = std::string(text)};
+		dispatch(content);
 	}
 } // namespace
 
 /**
  * @brief  日志格式化打印实现
- * @param  module_id   Module Id
+ * 格式串由 std::format_string 在编译期检查, 参数按引用转发, 直接格式化到线程局部缓冲区
+ * @param  module_id   Module Id, 需要在程序运行期间一直有效 (通常是字符串字面量)
  * @param  location    location
  * @param  level       Log level
  * @param  fmt         Log format string
  */
 template <typename... Args>
-inline void LogPrintfFunc(const char* module_id, int level, const std::source_location location, const char* fmt,
-                          Args... args) {
+inline void LogPrintfFunc(const char* module_id, int level, const std::source_location location,
+                          std::format_string<Args...> fmt, Args&&... args) {
 	if (!can_dispatch()) {
 		return;
 	}
@@ -125,28 +825,20 @@ inline void LogPrintfFunc(const char* module_id, int level, const std::source_lo
 	if (level > LOG_LEVEL_TRACE) {
 		level = LOG_LEVEL_TRACE;
 	}
-	std::string module_id_print = (module_id != nullptr) ? module_id : "???";
-	const std::chrono::zoned_time now{std::chrono::current_zone(), std::chrono::high_resolution_clock::now()};
-	std::string text{};
+	const LogClock::time_point now = LogClock::now();
+	TextBuffer buffer;
+	std::string& text = buffer.get();
 	try {
-		if (fmt != nullptr) {
-			text = std::vformat(fmt, std::make_format_args(args...));
-		}
+		std::format_to(std::back_inserter(text), fmt, std::forward<Args>(args)...);
 	} catch (std::format_error& e) {
-		LogPrintfFunc(module_id, LOG_LEVEL_WARN, location, "[format parse error]", e.what());
-		return;
+		//! 格式串已在编译期检查, 这里只剩动态宽度/精度参数非法之类的运行期错误
+		text.assign("[format error] ");
+		text += e.what();
 	}
-	LogContent content = {.thread_id = std::this_thread::get_id(),
-	                      .timestamp = std::format("{}", now),
-	                      .module_id = std::move(module_id_print),
-	                      .location = location,
-	                      .level = level,
-	                      .text = std::move(text)};
-
-	dispatch(content);
+	log_submit(module_id, level, location, now, text);
 }
 /**
- * @brief 注册一个回调事件
+ * @brief 注册一个回调事件, 回调可能被多个线程同时调用
  *
  * @param func
  * @param ptr
@@ -156,11 +848,15 @@ inline uint32_t log_add_print_func(LogPrintfFuncType func, void* ptr) {
 	std::unique_lock<std::mutex> _lock(_mtx);
 	uint32_t new_id = ++_id_alloc;
 	OutputChannel channel = {.id = new_id, .func = func, .ptr = ptr};
-	_output_channels.push_back(channel);
+	const ChannelList* old = _output_channels.load(std::memory_order_relaxed);
+	auto* list = (old != nullptr) ? new ChannelList(*old) : new ChannelList();
+	list->push_back(channel);
+	publish_channels(list);
 	return new_id;
 }
 /**
  * @brief 移除一个回调事件
+ * 不在回调中调用时, 返回前会等待仍在使用旧快照的线程结束, 之后该回调不会再被调用
  *
  * @param id
  * @return true
@@ -168,14 +864,28 @@ inline uint32_t log_add_print_func(LogPrintfFuncType func, void* ptr) {
  */
 inline bool log_remove_print_func(uint32_t id) {
 	std::unique_lock<std::mutex> _lock(_mtx);
-	auto iter = std::remove_if(_output_channels.begin(), _output_channels.end(),
-	                           [id](const OutputChannel& item) { return (item.id == id); });
-
-	if (iter != _output_channels.end()) {
-		_output_channels.erase(iter, _output_channels.end());
-		return true;
+	const ChannelList* old = _output_channels.load(std::memory_order_relaxed);
+	if (old == nullptr ||
+	    std::none_of(old->begin(), old->end(), [id](const OutputChannel& item) { return (item.id == id); })) {
+		return false;
+	}
+	auto* list = new ChannelList(*old);
+	std::erase_if(*list, [id](const OutputChannel& item) { return (item.id == id); });
+	if (list->empty()) {
+		delete list;
+		list = nullptr;
 	}
-	return false;
+	publish_channels(list);
+	_lock.unlock();
+	if (_dispatch_depth == 0) {
+		//! 只比较地址不解引用, old 可能已被其他线程回收
+		for (const auto& item : _hazard_slots) {
+			while (item.ptr.load(std::memory_order_seq_cst) == old) {
+				std::this_thread::yield();
+			}
+		}
+	}
+	return true;
 }
 namespace {
 	const char* level_name = "FEWNIDT";
@@ -187,7 +897,7 @@ namespace {
 			ss << std::vformat("\033[{}m{} ",
 			                   std::make_format_args(level_color_num[content->level], level_name[content->level]));
 			//! 打印时间戳、线程号、模块名
-			ss << std::format("{} ", content->timestamp);
+			ss << log_format_timestamp(content->timestamp) << " ";
 			ss << content->thread_id;
 			ss << std::format(" {} ", content->module_id);
 			ss << content->location.function_name() << " ";
@@ -196,12 +906,1478 @@ namespace {
 			if (content->location.function_name() != nullptr)
 				ss << std::format(" -- {}:{}", content->location.file_name(), content->location.line());
 			//! 恢复色彩
-			ss << std::string{"\033[0m"};
-			std::cout << ss.str() << std::endl;
+			ss << std::string{"\033[0m"} << '\n';
+			//! 回调可能并发执行, 整行一次写出避免交错
+			std::cout << ss.str() << std::flush;
+		}
+	}
+} // namespace
+
+//! 文件输出的落盘策略
+enum class LogFsyncPolicy {
+	None,       //!< 只写入页缓存
+	Periodic,   //!< 每隔 fsync_interval 调用一次 fdatasync
+	EveryBatch, //!< 每批 writev 之后调用 fdatasync
+};
+
+struct LogFileOptions {
+	std::string path;
+	size_t queue_capacity = 8192;                      //!< 回调线程与后台线程之间无锁队列的容量 (条), 满时生产者等待
+	size_t buffer_size = 1 << 20;                      //!< 后台线程单个写缓冲区的大小
+	size_t max_buffers = 8;                            //!< 一次 writev 最多写出的缓冲区个数
+	size_t rotate_size = 0;                            //!< 文件超过该大小时轮转, 0 表示不按大小轮转
+	std::chrono::seconds rotate_interval{0};           //!< 每隔多久轮转一次, 0 表示不按时间轮转
+	size_t max_files = 5;                              //!< 保留 path.1 ~ path.max_files
+	std::chrono::milliseconds flush_interval{100};     //!< 未写满的缓冲区最多等待多久写出
+	LogFsyncPolicy fsync = LogFsyncPolicy::None;
+	std::chrono::milliseconds fsync_interval{1000};
+};
+
+/**
+ * @brief 文件输出: 回调线程只把日志放入无锁队列 (LogRingBuffer), 后台线程取出后格式化到大缓冲区, 用 writev 批量写入 O_APPEND 打开的文件
+ * 后台线程每隔 flush_interval 或队列积压到一半时被唤醒; 格式化、轮转和 fsync 都在后台线程完成, 不阻塞打印日志的线程
+ */
+class LogFileSink {
+public:
+	explicit LogFileSink(LogFileOptions options)
+	    : _options(std::move(options)), _queue(std::max<size_t>(_options.queue_capacity, 2)) {
+		_options.buffer_size = std::max<size_t>(_options.buffer_size, 4096);
+		_options.max_buffers = std::max<size_t>(_options.max_buffers, 1);
+		_fd = open_file();
+		if (_fd < 0) {
+			return;
+		}
+		_file_size = current_size();
+		_opened_at = std::chrono::steady_clock::now();
+		_buffers.resize(_options.max_buffers);
+		for (auto& buffer : _buffers) {
+			buffer.reserve(_options.buffer_size);
+		}
+		_writer = std::thread(&LogFileSink::run, this);
+		_channel_id = log_add_print_func(&LogFileSink::output, this);
+	}
+	LogFileSink(const LogFileSink&) = delete;
+	LogFileSink& operator=(const LogFileSink&) = delete;
+	~LogFileSink() {
+		if (_fd < 0) {
+			return;
+		}
+		log_remove_print_func(_channel_id);
+		{
+			std::unique_lock<std::mutex> _lock(_mtx);
+			_stop = true;
+		}
+		_writer_cv.notify_one();
+		_writer.join();
+		::close(_fd);
+	}
+
+	bool ok() const { return _fd >= 0; }
+	//! 写出或 fdatasync 失败时的 errno, 0 表示没有出错
+	int error() const { return _error.load(std::memory_order_relaxed); }
+	/**
+	 * @brief 等待调用前已放入队列的日志全部写出
+	 */
+	void flush() {
+		std::unique_lock<std::mutex> _lock(_mtx);
+		const uint64_t ticket = ++_flush_requested;
+		_writer_cv.notify_one();
+		_producer_cv.wait(_lock, [&] { return _flush_done >= ticket || _writer_exited; });
+	}
+
+	static void output(const LogContent* content, void* ptr) { static_cast<LogFileSink*>(ptr)->append(*content); }
+
+private:
+	//! 回调线程: 只做一次无锁入队; 队列满或积压到一半时才加锁唤醒后台线程
+	void append(const LogContent& content) {
+		size_t pos;
+		while (!_queue.try_push(content, &pos)) {
+			wake_writer();
+			std::this_thread::yield();
+		}
+		const size_t half = _queue.capacity() / 2;
+		if ((pos + 1) % half == 0) {
+			wake_writer();
+		}
+	}
+	void wake_writer() {
+		{
+			std::unique_lock<std::mutex> _lock(_mtx);
+			_wake = true;
+		}
+		_writer_cv.notify_one();
+	}
+
+	//! 与 _print_log_to_stdout 相同的字段, 不带色彩; 逐段追加避免每行的格式串解析
+	void format_line(const LogContent& content, std::string& line) {
+		if (_cached_id != content.thread_id) {
+			std::ostringstream ss;
+			ss << content.thread_id;
+			_cached_id = content.thread_id;
+			_cached_id_str = ss.str();
+		}
+		char line_no[16];
+		const auto line_end = std::to_chars(line_no, line_no + sizeof(line_no), content.location.line()).ptr;
+		line += level_name[content.level];
+		line += ' ';
+		line += log_format_timestamp(content.timestamp);
+		line += ' ';
+		line += _cached_id_str;
+		line += ' ';
+		line += content.module_id;
+		line += ' ';
+		line += content.location.function_name();
+		line += ' ';
+		line += content.text;
+		line += " -- ";
+		line += content.location.file_name();
+		line += ':';
+		line.append(line_no, line_end);
+		line += '\n';
+	}
+
+	int open_file() { return ::open(_options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644); }
+	//! O_APPEND 打开的已有文件从原大小继续计数, 轮转判断才准确
+	size_t current_size() {
+		struct stat st {};
+		if (::fstat(_fd, &st) != 0) {
+			_error.store(errno, std::memory_order_relaxed);
+			return 0;
+		}
+		return static_cast<size_t>(st.st_size);
+	}
+	void sync() {
+		if (::fdatasync(_fd) != 0) {
+			_error.store(errno, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @brief path.(n-1) -> path.n, ..., path -> path.1, 然后重新打开 path
+	 */
+	void rotate() {
+		if (_options.max_files == 0) {
+			if (::ftruncate(_fd, 0) != 0) {
+				_error.store(errno, std::memory_order_relaxed);
+			}
+		} else {
+			const std::string& path = _options.path;
+			::unlink(std::format("{}.{}", path, _options.max_files).c_str());
+			for (size_t i = _options.max_files; i > 1; i--) {
+				::rename(std::format("{}.{}", path, i - 1).c_str(), std::format("{}.{}", path, i).c_str());
+			}
+			::rename(path.c_str(), std::format("{}.1", path).c_str());
+			const int fd = open_file();
+			if (fd < 0) {
+				_error.store(errno, std::memory_order_relaxed);
+				return;
+			}
+			::close(_fd);
+			_fd = fd;
+		}
+		_file_size = current_size();
+		_opened_at = std::chrono::steady_clock::now();
+	}
+
+	//! 写出 _buffers 中前 count 个缓冲区并清空
+	void write_batch(size_t count) {
+		_iov.clear();
+		for (size_t i = 0; i < count; i++) {
+			if (!_buffers[i].empty()) {
+				_iov.push_back({.iov_base = _buffers[i].data(), .iov_len = _buffers[i].size()});
+			}
+		}
+		size_t index = 0;
+		while (index < _iov.size()) {
+			const int iov_count = static_cast<int>(std::min<size_t>(_iov.size() - index, IOV_MAX));
+			const ssize_t written = ::writev(_fd, _iov.data() + index, iov_count);
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				_error.store(errno, std::memory_order_relaxed);
+				break;
+			}
+			_file_size += static_cast<size_t>(written);
+			//! 处理部分写入
+			size_t left = static_cast<size_t>(written);
+			while (index < _iov.size() && left >= _iov[index].iov_len) {
+				left -= _iov[index].iov_len;
+				index++;
+			}
+			if (index < _iov.size()) {
+				_iov[index].iov_base = static_cast<char*>(_iov[index].iov_base) + left;
+				_iov[index].iov_len -= left;
+			}
+		}
+		for (size_t i = 0; i < count; i++) {
+			_buffers[i].clear();
+		}
+		if (_options.fsync == LogFsyncPolicy::EveryBatch) {
+			sync();
+		}
+		maintain();
+	}
+	//! 定期 fdatasync 和轮转; 每批写出后以及每次唤醒时检查, 空闲时也会按时间进行
+	void maintain() {
+		const auto now = std::chrono::steady_clock::now();
+		if (_options.fsync == LogFsyncPolicy::Periodic && now - _last_sync >= _options.fsync_interval) {
+			sync();
+			_last_sync = now;
+		}
+		if ((_options.rotate_size != 0 && _file_size >= _options.rotate_size) ||
+		    (_options.rotate_interval.count() != 0 && now - _opened_at >= _options.rotate_interval)) {
+			rotate();
+		}
+	}
+
+	//! 逐行格式化到缓冲区, 所有缓冲区写满时先写出一批; 每轮最多取 capacity 条, 即本轮开始时已在队列中的日志,
+	//! 之后入队的留到下一轮, 生产者持续写日志时这一轮也会结束, flush 不会一直等下去
+	void drain() {
+		size_t used = 0;
+		for (size_t popped = 0;
+		     popped < _queue.capacity() && _queue.try_pop([&](const LogContent& content) { format_line(content, _buffers[used]); });
+		     popped++) {
+			if (_buffers[used].size() >= _options.buffer_size && ++used == _buffers.size()) {
+				write_batch(used);
+				used = 0;
+			}
+		}
+		if (used != 0 || !_buffers[0].empty()) {
+			write_batch(used + 1);
+		}
+	}
+
+	void run() {
+		_last_sync = std::chrono::steady_clock::now();
+		for (;;) {
+			bool stop;
+			uint64_t flush_requested;
+			{
+				std::unique_lock<std::mutex> _lock(_mtx);
+				_writer_cv.wait_for(_lock, _options.flush_interval,
+				                    [&] { return _wake || _stop || _flush_requested != _flush_done; });
+				_wake = false;
+				stop = _stop;
+				flush_requested = _flush_requested;
+			}
+			drain();
+			maintain();
+			if (stop && _options.fsync != LogFsyncPolicy::None) {
+				sync();
+			}
+			{
+				std::unique_lock<std::mutex> _lock(_mtx);
+				_flush_done = flush_requested;
+				_writer_exited = stop;
+			}
+			_producer_cv.notify_all();
+			if (stop) {
+				return;
+			}
+		}
+	}
+
+	LogFileOptions _options;
+	LogRingBuffer _queue;
+	int _fd = -1;
+	uint32_t _channel_id = 0;
+	std::atomic<int> _error{0};
+
+	//! 以下只由后台线程访问
+	size_t _file_size = 0;
+	std::chrono::steady_clock::time_point _opened_at;
+	std::chrono::steady_clock::time_point _last_sync;
+	std::vector<std::string> _buffers;
+	std::vector<iovec> _iov;
+	std::thread::id _cached_id;
+	std::string _cached_id_str;
+
+	//! 以下由 _mtx 保护, 只用于唤醒后台线程和 flush 等待, 不在每条日志的路径上
+	std::mutex _mtx;
+	std::condition_variable _writer_cv;
+	std::condition_variable _producer_cv;
+	bool _wake = false;
+	bool _stop = false;
+	bool _writer_exited = false;
+	uint64_t _flush_requested = 0;
+	uint64_t _flush_done = 0;
+	std::thread _writer;
+};
+
+/**
+ * @brief 飞行记录仪: 把日志写进固定大小的 mmap 文件环形缓冲区, 热路径没有系统调用
+ * 数据在页缓存中, 进程崩溃后依然保留, 用 log_flight_dump 按时间顺序导出最近的记录
+ * 文件格式: 4KB 头 ("LOGFR001", 容量, 写入位置) + 环形数据区;
+ * 每条记录 16 字节对齐, 不跨越数据区末尾, 记录头中的绝对位置最后写入, 作为提交标记;
+ * 写入线程被其他线程套圈时记录可能被覆盖, 导出时位置不匹配的记录会被跳过
+ */
+namespace log_flight {
+	inline constexpr char file_magic[8] = {'L', 'O', 'G', 'F', 'R', '0', '0', '1'};
+	inline constexpr size_t header_size = 4096;
+	inline constexpr size_t record_align = 16;
+	inline constexpr uint16_t kind_record = 1;
+	inline constexpr uint16_t kind_padding = 2;
+
+	struct FileHeader {
+		char magic[8];
+		uint64_t capacity;
+		uint64_t head; //!< 下一条记录的绝对位置, 通过 std::atomic_ref 访问
+	};
+	struct RecordHeader {
+		uint64_t pos; //!< 记录的绝对位置, 与所在偏移对应时记录才有效
+		uint32_t len; //!< 包括记录头, 16 字节对齐
+		uint16_t kind;
+		uint16_t level;
+	};
+	struct RecordBody {
+		int64_t timestamp; //!< LogClock 纳秒
+		uint64_t thread;   //!< std::hash<std::thread::id>
+		uint32_t line;
+		uint32_t text_len;
+		uint16_t module_len;
+		uint16_t file_len;
+		uint16_t function_len;
+		uint16_t reserved;
+	};
+	static_assert(sizeof(RecordHeader) == 16 && sizeof(RecordBody) == 32);
+
+	constexpr size_t align_record(size_t size) { return (size + record_align - 1) & ~(record_align - 1); }
+} // namespace log_flight
+
+class LogFlightRecorder {
+public:
+	/**
+	 * @param path      文件路径, 已存在且容量相同时接着上次的位置继续写
+	 * @param capacity  环形数据区大小, 向上取整到 4KB
+	 * @param max_level 只记录等级不大于 max_level 的日志, 默认全部记录
+	 */
+	LogFlightRecorder(const char* path, size_t capacity, int max_level = LOG_LEVEL_TRACE) : _max_level(max_level) {
+		_capacity = std::max<size_t>((capacity + 4095) & ~size_t{4095}, 4096);
+		_fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (_fd < 0) {
+			return;
+		}
+		struct stat st {};
+		const bool reuse = ::fstat(_fd, &st) == 0 && static_cast<size_t>(st.st_size) == log_flight::header_size + _capacity;
+		if (!reuse && ::ftruncate(_fd, static_cast<off_t>(log_flight::header_size + _capacity)) != 0) {
+			close_file();
+			return;
+		}
+		void* addr = ::mmap(nullptr, log_flight::header_size + _capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+		if (addr == MAP_FAILED) {
+			close_file();
+			return;
+		}
+		_map = static_cast<std::byte*>(addr);
+		_header = reinterpret_cast<log_flight::FileHeader*>(_map);
+		if (!reuse || memcmp(_header->magic, log_flight::file_magic, sizeof(log_flight::file_magic)) != 0 ||
+		    _header->capacity != _capacity) {
+			memset(_map, 0, log_flight::header_size + _capacity);
+			memcpy(_header->magic, log_flight::file_magic, sizeof(log_flight::file_magic));
+			_header->capacity = _capacity;
+			_header->head = 0;
+		}
+		_channel_id = log_add_print_func(&LogFlightRecorder::output, this);
+	}
+	LogFlightRecorder(const LogFlightRecorder&) = delete;
+	LogFlightRecorder& operator=(const LogFlightRecorder&) = delete;
+	~LogFlightRecorder() {
+		if (_map == nullptr) {
+			return;
+		}
+		log_remove_print_func(_channel_id);
+		::munmap(_map, log_flight::header_size + _capacity);
+		close_file();
+	}
+
+	bool ok() const { return _map != nullptr; }
+
+	static void output(const LogContent* content, void* ptr) { static_cast<LogFlightRecorder*>(ptr)->record(*content); }
+
+private:
+	void close_file() {
+		::close(_fd);
+		_fd = -1;
+	}
+
+	void record(const LogContent& content) {
+		if (content.level > _max_level) {
+			return;
+		}
+		//! 单条记录最多占数据区的 1/16, 过长的文本截断
+		const std::string_view file = content.location.file_name();
+		const std::string_view function = content.location.function_name();
+		const size_t fixed = sizeof(log_flight::RecordHeader) + sizeof(log_flight::RecordBody);
+		const size_t names = std::min<size_t>(content.module_id.size(), UINT16_MAX) +
+		                     std::min<size_t>(file.size(), UINT16_MAX) + std::min<size_t>(function.size(), UINT16_MAX);
+		const size_t limit = _capacity / 16;
+		if (fixed + names >= limit) {
+			return;
+		}
+		const size_t text_len = std::min(content.text.size(), limit - fixed - names);
+		const size_t len = log_flight::align_record(fixed + names + text_len);
+
+		std::byte* data = _map + log_flight::header_size;
+		std::atomic_ref<uint64_t> head(_header->head);
+		uint64_t pos = head.load(std::memory_order_relaxed);
+		uint64_t start;
+		for (;;) {
+			const size_t offset = pos % _capacity;
+			//! 放不下时先用一条填充记录占满到末尾, 正式记录从数据区开头开始
+			start = (_capacity - offset < len) ? pos + (_capacity - offset) : pos;
+			if (head.compare_exchange_weak(pos, start + len, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+		if (start != pos) {
+			publish(data + pos % _capacity, pos, static_cast<uint32_t>(start - pos), log_flight::kind_padding, 0);
+		}
+
+		std::byte* p = data + start % _capacity + sizeof(log_flight::RecordHeader);
+		const log_flight::RecordBody body = {
+		    .timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(content.timestamp.time_since_epoch()).count(),
+		    .thread = std::hash<std::thread::id>{}(content.thread_id),
+		    .line = content.location.line(),
+		    .text_len = static_cast<uint32_t>(text_len),
+		    .module_len = static_cast<uint16_t>(std::min<size_t>(content.module_id.size(), UINT16_MAX)),
+		    .file_len = static_cast<uint16_t>(std::min<size_t>(file.size(), UINT16_MAX)),
+		    .function_len = static_cast<uint16_t>(std::min<size_t>(function.size(), UINT16_MAX)),
+		    .reserved = 0};
+		memcpy(p, &body, sizeof(body));
+		p += sizeof(body);
+		memcpy(p, content.module_id.data(), body.module_len);
+		p += body.module_len;
+		memcpy(p, file.data(), body.file_len);
+		p += body.file_len;
+		memcpy(p, function.data(), body.function_len);
+		p += body.function_len;
+		memcpy(p, content.text.data(), text_len);
+		publish(data + start % _capacity, start, static_cast<uint32_t>(len), log_flight::kind_record,
+		        static_cast<uint16_t>(content.level));
+	}
+	//! 先写长度和类型, 最后以 release 写入绝对位置, 崩溃时写了一半的记录位置不匹配会被跳过
+	static void publish(std::byte* at, uint64_t pos, uint32_t len, uint16_t kind, uint16_t level) {
+		auto* header = reinterpret_cast<log_flight::RecordHeader*>(at);
+		std::atomic_ref<uint64_t>(header->pos).store(UINT64_MAX, std::memory_order_relaxed);
+		header->len = len;
+		header->kind = kind;
+		header->level = level;
+		std::atomic_ref<uint64_t>(header->pos).store(pos, std::memory_order_release);
+	}
+
+	int _max_level;
+	size_t _capacity = 0;
+	int _fd = -1;
+	std::byte* _map = nullptr;
+	log_flight::FileHeader* _header = nullptr;
+	uint32_t _channel_id = 0;
+};
+
+/**
+ * @brief 按时间顺序导出飞行记录仪文件中仍然完整的记录, 每条一行
+ *
+ * @return false 文件无法读取或格式不对
+ */
+inline bool log_flight_dump(const char* path, std::ostream& out) {
+	const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st {};
+	if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= log_flight::header_size) {
+		::close(fd);
+		return false;
+	}
+	const auto size = static_cast<size_t>(st.st_size);
+	void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED) {
+		return false;
+	}
+	const auto* map = static_cast<const std::byte*>(addr);
+	log_flight::FileHeader file_header;
+	memcpy(&file_header, map, sizeof(file_header));
+	if (memcmp(file_header.magic, log_flight::file_magic, sizeof(file_header.magic)) != 0 ||
+	    file_header.capacity != size - log_flight::header_size) {
+		::munmap(addr, size);
+		return false;
+	}
+	const size_t capacity = file_header.capacity;
+	const std::byte* data = map + log_flight::header_size;
+	const uint64_t head = file_header.head;
+	//! 最旧的位置可能落在某条记录中间, 按 16 字节步进直到找到位置匹配的记录头
+	uint64_t pos = (head > capacity) ? head - capacity : 0;
+	pos = log_flight::align_record(pos);
+	while (pos < head) {
+		log_flight::RecordHeader header;
+		memcpy(&header, data + pos % capacity, sizeof(header));
+		const size_t room = capacity - pos % capacity;
+		if (header.pos != pos || header.len < sizeof(header) || header.len > room || header.len % log_flight::record_align) {
+			pos += log_flight::record_align;
+			continue;
+		}
+		if (header.kind == log_flight::kind_record &&
+		    header.len >= sizeof(header) + sizeof(log_flight::RecordBody)) {
+			const std::byte* p = data + pos % capacity + sizeof(header);
+			log_flight::RecordBody body;
+			memcpy(&body, p, sizeof(body));
+			const size_t payload = size_t{body.module_len} + body.file_len + body.function_len + body.text_len;
+			if (sizeof(header) + sizeof(body) + payload <= header.len) {
+				const auto* str = reinterpret_cast<const char*>(p + sizeof(body));
+				const std::string_view module_id(str, body.module_len);
+				const std::string_view file(str + body.module_len, body.file_len);
+				const std::string_view function(str + body.module_len + body.file_len, body.function_len);
+				const std::string_view text(str + payload - body.text_len, body.text_len);
+				const LogClock::time_point when(
+				    std::chrono::duration_cast<LogClock::duration>(std::chrono::nanoseconds(body.timestamp)));
+				out << "FEWNIDT"[std::min<uint16_t>(header.level, LOG_LEVEL_TRACE)] << ' ' << log_format_timestamp(when)
+				    << ' ' << body.thread << ' ' << module_id << ' ' << function << ' ' << text << " -- " << file << ':'
+				    << body.line << '\n';
+			}
 		}
+		pos += header.len;
 	}
+	::munmap(addr, size);
+	return true;
+}
+
+/**
+ * @brief 二进制延迟格式化模式 (LOG_BINARY_MODE)
+ * 调用点只写入静态注册的 call-site ID、时间戳和参数的原始字节, 放进本线程的 SPSC 缓冲区;
+ * 格式化由后台线程完成 (直接输出到注册的回调), 或者写入二进制文件后用 log_decode 离线解码
+ * 文件格式: "LOGBIN01" 之后是若干 [u32 kind][u32 len][payload], kind 1 为调用点定义, kind 2 为一条日志
+ */
+namespace log_struct {
+	/**
+	 * @brief 以 JSON 字符串 (带引号, 转义引号、反斜杠和控制字符) 追加 str
+	 * LogStruct 的文本路径和二进制模式的 {:j} 占位共用
+	 */
+	inline void append_string(std::string& out, std::string_view str) {
+		static constexpr char hex[] = "0123456789abcdef";
+		out += '"';
+		for (char ch : str) {
+			switch (ch) {
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\r':
+				out += "\\r";
+				break;
+			case '\t':
+				out += "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(ch) < 0x20) {
+					out += "\\u00";
+					out += hex[(ch >> 4) & 0xf];
+					out += hex[ch & 0xf];
+				} else {
+					out += ch;
+				}
+			}
+		}
+		out += '"';
+	}
+} // namespace log_struct
+
+namespace log_binary {
+	inline constexpr char file_magic[8] = {'L', 'O', 'G', 'B', 'I', 'N', '0', '1'};
+	inline constexpr uint32_t chunk_site = 1;
+	inline constexpr uint32_t chunk_record = 2;
+	inline constexpr uint32_t wrap_marker = UINT32_MAX;
+	//! register_site 对 format_args 无法处理的格式串返回该值, write 直接返回 false
+	inline constexpr uint32_t text_site = UINT32_MAX;
+	//! 缓冲区中一条记录的头: [u32 len][u32 site][i64 timestamp ns]
+	inline constexpr size_t record_header = 16;
+	//! 单条记录的上限, 更大的记录走普通格式化路径
+	inline constexpr size_t max_record = 16 << 20;
+	//! 文件中单个块的上限, 解码时超过即视为文件损坏, 不按其中的长度分配内存
+	inline constexpr uint32_t max_chunk = 64 << 20;
+
+	/**
+	 * @brief 参数类型标记: b bool, c char, i 有符号整数, u 无符号整数, f float, d double, s 字符串, p 指针
+	 */
+	template <typename T>
+	constexpr char tag_of() {
+		if constexpr (std::is_same_v<T, bool>) {
+			return 'b';
+		} else if constexpr (std::is_same_v<T, char>) {
+			return 'c';
+		} else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+			return 'i';
+		} else if constexpr (std::is_integral_v<T>) {
+			return 'u';
+		} else if constexpr (std::is_same_v<T, float>) {
+			return 'f';
+		} else if constexpr (std::is_same_v<T, double>) {
+			return 'd';
+		} else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+			return 's';
+		} else if constexpr (std::is_pointer_v<T>) {
+			return 'p';
+		} else {
+			static_assert(!sizeof(T), "unsupported argument type for binary log");
+		}
+	}
+	template <typename... Args>
+	struct type_list {};
+	//! 只用于 decltype 推导参数类型, 不会对参数求值
+	template <typename... Args>
+	type_list<std::decay_t<Args>...> deduce(const Args&...);
+	template <typename List>
+	struct arg_tags;
+	template <typename... Args>
+	struct arg_tags<type_list<Args...>> {
+		static constexpr char value[] = {tag_of<Args>()..., '\0'};
+	};
+
+	//! 's' 参数的长度字段为该值时表示空指针 (值为 nullptr 的 const char*), 后面没有字符
+	inline constexpr uint32_t null_string = UINT32_MAX;
+	template <typename T>
+	bool is_null_string(const T& arg) {
+		if constexpr (std::is_pointer_v<T>) {
+			return arg == nullptr;
+		} else {
+			return false;
+		}
+	}
+
+	template <typename T>
+	size_t arg_size(const T& arg) {
+		if constexpr (tag_of<T>() == 's') {
+			return sizeof(uint32_t) + (is_null_string(arg) ? 0 : std::string_view(arg).size());
+		} else if constexpr (tag_of<T>() == 'b' || tag_of<T>() == 'c') {
+			return 1;
+		} else if constexpr (tag_of<T>() == 'f') {
+			return sizeof(float);
+		} else {
+			return 8;
+		}
+	}
+	template <typename T>
+	std::byte* encode_arg(std::byte* p, const T& arg) {
+		constexpr char tag = tag_of<T>();
+		if constexpr (tag == 's') {
+			if (is_null_string(arg)) {
+				memcpy(p, &null_string, sizeof(null_string));
+				return p + sizeof(null_string);
+			}
+			const std::string_view str(arg);
+			const auto len = static_cast<uint32_t>(str.size());
+			memcpy(p, &len, sizeof(len));
+			memcpy(p + sizeof(len), str.data(), len);
+			return p + sizeof(len) + len;
+		} else if constexpr (tag == 'b' || tag == 'c') {
+			*p = static_cast<std::byte>(arg);
+			return p + 1;
+		} else if constexpr (tag == 'f') {
+			memcpy(p, &arg, sizeof(float));
+			return p + sizeof(float);
+		} else {
+			uint64_t raw;
+			if constexpr (tag == 'i') {
+				const auto value = static_cast<int64_t>(arg);
+				memcpy(&raw, &value, 8);
+			} else if constexpr (tag == 'u') {
+				raw = static_cast<uint64_t>(arg);
+			} else if constexpr (tag == 'd') {
+				memcpy(&raw, &arg, 8);
+			} else {
+				raw = reinterpret_cast<uintptr_t>(arg);
+			}
+			memcpy(p, &raw, 8);
+			return p + 8;
+		}
+	}
+
+	//! std::nullptr_t 来自值为 nullptr 的字符串参数
+	using Arg = std::variant<bool, char, int64_t, uint64_t, float, double, std::string_view, const void*, std::nullptr_t>;
+
+	/**
+	 * @brief 按类型标记从 p 读出参数, 数据不完整时返回 false
+	 */
+	inline bool decode_args(const char* tags, const std::byte*& p, const std::byte* end, std::vector<Arg>& args) {
+		args.clear();
+		for (; *tags != '\0'; tags++) {
+			const size_t need = (*tags == 'b' || *tags == 'c') ? 1 : (*tags == 'f' || *tags == 's') ? 4 : 8;
+			if (static_cast<size_t>(end - p) < need) {
+				return false;
+			}
+			switch (*tags) {
+			case 'b':
+				args.emplace_back(*p != std::byte{0});
+				break;
+			case 'c':
+				args.emplace_back(static_cast<char>(*p));
+				break;
+			case 'f': {
+				float value;
+				memcpy(&value, p, need);
+				args.emplace_back(value);
+				break;
+			}
+			case 's': {
+				uint32_t len;
+				memcpy(&len, p, need);
+				if (len == null_string) {
+					args.emplace_back(nullptr);
+					break;
+				}
+				if (static_cast<size_t>(end - p) - need < len) {
+					return false;
+				}
+				args.emplace_back(std::string_view(reinterpret_cast<const char*>(p + need), len));
+				p += len;
+				break;
+			}
+			default: {
+				uint64_t raw;
+				memcpy(&raw, p, need);
+				if (*tags == 'i') {
+					args.emplace_back(static_cast<int64_t>(raw));
+				} else if (*tags == 'u') {
+					args.emplace_back(raw);
+				} else if (*tags == 'd') {
+					args.emplace_back(std::bit_cast<double>(raw));
+				} else {
+					args.emplace_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(raw)));
+				}
+				break;
+			}
+			}
+			p += need;
+		}
+		return true;
+	}
+	/**
+	 * @brief 解析替换域的参数下标: 为空时取自动编号 next++, 否则必须是十进制数
+	 * @return false 下标含有非数字字符或溢出
+	 */
+	inline bool parse_arg_index(std::string_view index, size_t& next, size_t& arg_id) {
+		if (index.empty()) {
+			arg_id = next++;
+			return true;
+		}
+		const auto [ptr, ec] = std::from_chars(index.data(), index.data() + index.size(), arg_id);
+		return ec == std::errc() && ptr == index.data() + index.size();
+	}
+	/**
+	 * @brief fmt 能否由 format_args 处理: 每个替换域的下标小于 arg_count, 格式说明中没有嵌套的 {} (动态宽度/精度)
+	 * 不能处理的调用点在注册时标记为 text_site, 始终走普通格式化路径
+	 */
+	inline bool binary_formattable(std::string_view fmt, size_t arg_count) {
+		size_t next = 0;
+		for (size_t i = 0; i < fmt.size(); i++) {
+			const char ch = fmt[i];
+			if ((ch == '{' || ch == '}') && i + 1 < fmt.size() && fmt[i + 1] == ch) {
+				i++;
+				continue;
+			}
+			if (ch != '{') {
+				continue;
+			}
+			const size_t close = fmt.find('}', i);
+			if (close == std::string_view::npos) {
+				return false;
+			}
+			const std::string_view field = fmt.substr(i + 1, close - i - 1);
+			size_t arg_id;
+			if (field.find('{') != std::string_view::npos || !parse_arg_index(field.substr(0, field.find(':')), next, arg_id) ||
+			    arg_id >= arg_count) {
+				return false;
+			}
+			i = close;
+		}
+		return true;
+	}
+	/**
+	 * @brief 二进制模式 LogStruct 的 {:j} 占位: 按 JSON 值输出, 字符串和字符转义, 非有限浮点数和空字符串指针输出 null
+	 */
+	inline void append_json(std::string& out, const Arg& arg) {
+		std::visit(
+		    [&out](const auto& value) {
+			    using V = std::decay_t<decltype(value)>;
+			    if constexpr (std::is_same_v<V, std::nullptr_t>) {
+				    out += "null";
+			    } else if constexpr (std::is_same_v<V, std::string_view>) {
+				    log_struct::append_string(out, value);
+			    } else if constexpr (std::is_same_v<V, char>) {
+				    log_struct::append_string(out, std::string_view(&value, 1));
+			    } else if constexpr (std::is_same_v<V, bool>) {
+				    out += value ? "true" : "false";
+			    } else if constexpr (std::is_same_v<V, const void*>) {
+				    std::format_to(std::back_inserter(out), "\"{}\"", value);
+			    } else if constexpr (std::is_floating_point_v<V>) {
+				    if (!std::isfinite(value)) {
+					    out += "null";
+					    return;
+				    }
+				    char buf[32];
+				    out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+			    } else {
+				    char buf[24];
+				    out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+			    }
+		    },
+		    arg);
+	}
+	/**
+	 * @brief 用解码出的参数逐个替换 fmt 中的 {} / {n} / {:spec} / {n:spec}, {:j} 见 append_json
+	 * 不支持动态宽度/精度 ({:{}}), 这类格式串在注册时已退回普通格式化, 离线解码遇到时输出解析错误
+	 */
+	inline std::string format_args(std::string_view fmt, const std::vector<Arg>& args) {
+		std::string out;
+		size_t next = 0;
+		try {
+			for (size_t i = 0; i < fmt.size(); i++) {
+				const char ch = fmt[i];
+				if ((ch == '{' || ch == '}') && i + 1 < fmt.size() && fmt[i + 1] == ch) {
+					out += ch;
+					i++;
+					continue;
+				}
+				if (ch != '{') {
+					out += ch;
+					continue;
+				}
+				const size_t close = fmt.find('}', i);
+				if (close == std::string_view::npos) {
+					throw std::format_error("unmatched '{'");
+				}
+				const std::string_view field = fmt.substr(i + 1, close - i - 1);
+				if (field.find('{') != std::string_view::npos) {
+					throw std::format_error("dynamic width or precision is not supported");
+				}
+				const size_t colon = field.find(':');
+				size_t arg_id;
+				if (!parse_arg_index(field.substr(0, colon), next, arg_id)) {
+					throw std::format_error("invalid argument index");
+				}
+				if (arg_id >= args.size()) {
+					throw std::format_error("argument index out of range");
+				}
+				if (colon != std::string_view::npos && field.substr(colon) == ":j") {
+					append_json(out, args[arg_id]);
+					i = close;
+					continue;
+				}
+				const std::string spec =
+				    std::string("{") + std::string(colon == std::string_view::npos ? "" : field.substr(colon)) + "}";
+				std::visit([&](const auto& value) { std::vformat_to(std::back_inserter(out), spec, std::make_format_args(value)); },
+				           args[arg_id]);
+				i = close;
+			}
+		} catch (std::format_error& e) {
+			out += std::format(" [format parse error] {}", e.what());
+		}
+		return out;
+	}
+
+	struct Site {
+		std::string module_id;
+		int level;
+		std::source_location location;
+		std::string fmt;
+		const char* tags;
+	};
+
+	/**
+	 * @brief 单生产者 (所属线程) 单消费者 (后台线程) 的字节环形缓冲区, 记录按 8 字节对齐且不跨越末尾
+	 */
+	class ThreadBuffer {
+	public:
+		explicit ThreadBuffer(size_t capacity)
+		    : _data(std::make_unique<std::byte[]>(capacity)), _capacity(capacity),
+		      _thread_id(std::this_thread::get_id()), _tid(static_cast<uint64_t>(syscall(SYS_gettid))) {}
+
+		size_t capacity() const { return _capacity; }
+		//! 预留 size 字节 (8 字节对齐) 的连续空间, 空间不足时等待后台线程读走
+		std::byte* reserve(size_t size) {
+			size_t offset = _head % _capacity;
+			const size_t waste = (_capacity - offset < size) ? _capacity - offset : 0;
+			while (_head + waste + size - _tail.load(std::memory_order_acquire) > _capacity) {
+				std::this_thread::yield();
+			}
+			if (waste != 0) {
+				memcpy(_data.get() + offset, &wrap_marker, sizeof(wrap_marker));
+				_head += waste;
+				offset = 0;
+			}
+			return _data.get() + offset;
+		}
+		void commit(size_t size) {
+			_head += size;
+			_published.store(_head, std::memory_order_release);
+		}
+		//! 后台线程读出所有已提交的记录, 返回读出的条数
+		template <typename Func>
+		size_t consume(Func&& func) {
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			const size_t head = _published.load(std::memory_order_acquire);
+			size_t count = 0;
+			while (tail != head) {
+				const size_t offset = tail % _capacity;
+				uint32_t len;
+				memcpy(&len, _data.get() + offset, sizeof(len));
+				if (len == wrap_marker) {
+					tail += _capacity - offset;
+					continue;
+				}
+				func(_data.get() + offset, static_cast<size_t>(len));
+				tail += len;
+				count++;
+			}
+			_tail.store(tail, std::memory_order_release);
+			return count;
+		}
+		bool empty() const { return _tail.load(std::memory_order_acquire) == _published.load(std::memory_order_acquire); }
+
+		std::thread::id thread_id() const { return _thread_id; }
+		uint64_t tid() const { return _tid; }
+		std::atomic<bool> retired{false};
+
+	private:
+		std::unique_ptr<std::byte[]> _data;
+		const size_t _capacity;
+		const std::thread::id _thread_id;
+		const uint64_t _tid;
+		size_t _head = 0; //!< 只由生产者访问
+		alignas(64) std::atomic<size_t> _published{0};
+		alignas(64) std::atomic<size_t> _tail{0};
+	};
+
+	struct State {
+		std::atomic<bool> enabled{false};
+		std::atomic<bool> stop{false};
+		size_t buffer_capacity = 1 << 20;
+		std::mutex site_mtx;
+		std::deque<Site> sites;
+		std::mutex buffer_mtx;
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+		std::FILE* file = nullptr;
+		std::thread writer;
+	};
+	//! 故意不析构: 线程退出和程序退出的顺序无法保证
+	inline State& state() {
+		static State* instance = new State;
+		return *instance;
+	}
+	inline bool enabled() { return state().enabled.load(std::memory_order_relaxed); }
+
+	inline uint32_t register_site(const char* module_id, int level, std::source_location location, const char* fmt,
+	                              const char* tags) {
+		if (!binary_formattable((fmt != nullptr) ? fmt : "", std::char_traits<char>::length(tags))) {
+			return text_site;
+		}
+		State& s = state();
+		std::unique_lock<std::mutex> _lock(s.site_mtx);
+		s.sites.push_back({.module_id = (module_id != nullptr) ? module_id : "???",
+		                   .level = std::clamp(level, 0, LOG_LEVEL_TRACE),
+		                   .location = location,
+		                   .fmt = (fmt != nullptr) ? fmt : "",
+		                   .tags = tags});
+		return static_cast<uint32_t>(s.sites.size() - 1);
+	}
+
+	//! 本线程的缓冲区句柄已在线程退出时析构; 之后 (其他 thread_local 的析构函数中) 的日志改走普通格式化路径
+	inline thread_local bool thread_buffer_destroyed = false;
+
+	/**
+	 * @brief 本线程的缓冲区, 首次调用时创建并登记给后台线程
+	 * @return nullptr 本线程的句柄已析构
+	 */
+	inline ThreadBuffer* thread_buffer() {
+		if (thread_buffer_destroyed) {
+			return nullptr;
+		}
+		struct Handle {
+			std::shared_ptr<ThreadBuffer> buffer;
+			Handle() {
+				State& s = state();
+				buffer = std::make_shared<ThreadBuffer>(s.buffer_capacity);
+				std::unique_lock<std::mutex> _lock(s.buffer_mtx);
+				s.buffers.push_back(buffer);
+			}
+			~Handle() {
+				buffer->retired.store(true, std::memory_order_release);
+				thread_buffer_destroyed = true;
+			}
+		};
+		thread_local Handle handle;
+		return handle.buffer.get();
+	}
+
+	/**
+	 * @brief 热路径: 把调用点 ID、时间戳和参数字节写入本线程缓冲区
+	 * 调用点是 text_site、本线程缓冲区已析构或单条记录超过缓冲区 1/4 (或 max_record) 时返回 false, 由调用方走普通格式化路径
+	 */
+	template <typename... Args>
+	bool write(uint32_t site, const Args&... args) {
+		ThreadBuffer* const buffer = (site != text_site) ? thread_buffer() : nullptr;
+		if (buffer == nullptr) {
+			return false;
+		}
+		const size_t size = (record_header + (size_t{0} + ... + arg_size(args)) + 7) & ~size_t{7};
+		if (size > buffer->capacity() / 4 || size > max_record) {
+			return false;
+		}
+		const int64_t timestamp =
+		    std::chrono::duration_cast<std::chrono::nanoseconds>(LogClock::now().time_since_epoch()).count();
+		std::byte* p = buffer->reserve(size);
+		const auto len = static_cast<uint32_t>(size);
+		memcpy(p, &len, sizeof(len));
+		memcpy(p + 4, &site, sizeof(site));
+		memcpy(p + 8, &timestamp, sizeof(timestamp));
+		[[maybe_unused]] std::byte* q = p + record_header;
+		((q = encode_arg(q, args)), ...);
+		buffer->commit(size);
+		return true;
+	}
+
+	inline void write_chunk(std::FILE* file, uint32_t kind, const std::string& payload) {
+		const auto len = static_cast<uint32_t>(payload.size());
+		std::fwrite(&kind, sizeof(kind), 1, file);
+		std::fwrite(&len, sizeof(len), 1, file);
+		std::fwrite(payload.data(), 1, payload.size(), file);
+	}
+	inline void append_string(std::string& out, std::string_view str) {
+		const auto len = static_cast<uint32_t>(str.size());
+		out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+		out.append(str);
+	}
+	template <typename T>
+	void append_pod(std::string& out, const T& value) {
+		out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	/**
+	 * @brief 后台线程: 轮询所有线程缓冲区, 写文件或格式化后分发给注册的回调
+	 * 空闲时休眠 1ms, 热路径不需要唤醒后台线程
+	 */
+	inline void writer_loop(State& s) {
+		std::vector<const Site*> sites;
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+		std::vector<Arg> args;
+		std::string payload;
+		auto sync_sites = [&](uint32_t site) {
+			std::unique_lock<std::mutex> _lock(s.site_mtx);
+			for (size_t i = sites.size(); i < s.sites.size(); i++) {
+				const Site& def = s.sites[i];
+				sites.push_back(&def);
+				if (s.file != nullptr) {
+					payload.clear();
+					append_pod(payload, static_cast<uint32_t>(i));
+					append_pod(payload, static_cast<int32_t>(def.level));
+					append_pod(payload, static_cast<uint32_t>(def.location.line()));
+					append_string(payload, def.module_id);
+					append_string(payload, def.location.file_name());
+					append_string(payload, def.location.function_name());
+					append_string(payload, def.fmt);
+					append_string(payload, def.tags);
+					write_chunk(s.file, chunk_site, payload);
+				}
+			}
+			return site < sites.size();
+		};
+		for (;;) {
+			const bool stop = s.stop.load(std::memory_order_acquire);
+			{
+				std::unique_lock<std::mutex> _lock(s.buffer_mtx);
+				buffers.assign(s.buffers.begin(), s.buffers.end());
+			}
+			size_t count = 0;
+			for (const auto& buffer : buffers) {
+				count += buffer->consume([&](const std::byte* record, size_t len) {
+					uint32_t site;
+					int64_t timestamp;
+					memcpy(&site, record + 4, sizeof(site));
+					memcpy(&timestamp, record + 8, sizeof(timestamp));
+					if (site >= sites.size() && !sync_sites(site)) {
+						return;
+					}
+					if (s.file != nullptr) {
+						payload.clear();
+						append_pod(payload, buffer->tid());
+						payload.append(reinterpret_cast<const char*>(record), len);
+						write_chunk(s.file, chunk_record, payload);
+						return;
+					}
+					const Site& def = *sites[site];
+					const std::byte* p = record + record_header;
+					std::string text = decode_args(def.tags, p, record + len, args) ? format_args(def.fmt, args)
+					                                                                  : "[binary log truncated]";
+					const LogContent content = {
+					    .thread_id = buffer->thread_id(),
+					    .timestamp = LogClock::time_point(std::chrono::duration_cast<LogClock::duration>(
+					        std::chrono::nanoseconds(timestamp))),
+					    .module_id = def.module_id,
+					    .location = def.location,
+					    .level = def.level,
+					    .text = std::move(text)};
+					dispatch(content);
+				});
+			}
+			{
+				//! 回收已退出且读空的线程缓冲区
+				std::unique_lock<std::mutex> _lock(s.buffer_mtx);
+				std::erase_if(s.buffers, [](const std::shared_ptr<ThreadBuffer>& buffer) {
+					return buffer->retired.load(std::memory_order_acquire) && buffer->empty();
+				});
+			}
+			if (count == 0) {
+				if (stop) {
+					return;
+				}
+				if (s.file != nullptr) {
+					std::fflush(s.file);
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+} // namespace log_binary
+
+/**
+ * @brief 开启二进制模式, LOG_BINARY_MODE 下的 LogPrintf 只记录原始参数
+ * 需要在没有其他线程打印日志时调用
+ *
+ * @param path            为 nullptr 时由后台线程格式化并输出到注册的回调; 否则写入该二进制文件, 用 log_decode 解码
+ * @param buffer_capacity 每个线程的缓冲区大小
+ * @return false 文件打开失败
+ */
+inline bool LogBinary_Enable(const char* path = nullptr, size_t buffer_capacity = 1 << 20) {
+	log_binary::State& s = log_binary::state();
+	if (s.enabled.load()) {
+		return true;
+	}
+	if (path != nullptr) {
+		s.file = std::fopen(path, "wb");
+		if (s.file == nullptr) {
+			return false;
+		}
+		std::fwrite(log_binary::file_magic, 1, sizeof(log_binary::file_magic), s.file);
+	}
+	s.buffer_capacity = std::max<size_t>(buffer_capacity, 4096) & ~size_t{7};
+	s.stop.store(false);
+	s.writer = std::thread(log_binary::writer_loop, std::ref(s));
+	s.enabled.store(true, std::memory_order_release);
+	return true;
+}
+/**
+ * @brief 关闭二进制模式, 处理完所有缓冲区中的日志后返回; 需要在没有其他线程打印日志时调用
+ */
+inline void LogBinary_Disable() {
+	log_binary::State& s = log_binary::state();
+	if (!s.enabled.exchange(false)) {
+		return;
+	}
+	s.stop.store(true, std::memory_order_release);
+	s.writer.join();
+	if (s.file != nullptr) {
+		std::fclose(s.file);
+		s.file = nullptr;
+	}
+}
+/**
+ * @brief 离线解码 LogBinary_Enable(path) 写出的文件, 每条日志输出一行
+ *
+ * 文件内容不可信: 块长度超过 log_binary::max_chunk、调用点编号跳号等都按格式错误处理
+ *
+ * @return false 文件格式错误或不完整
+ */
+inline bool log_binary_decode(std::FILE* in, std::ostream& out) {
+	char magic[sizeof(log_binary::file_magic)];
+	if (std::fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+	    memcmp(magic, log_binary::file_magic, sizeof(magic)) != 0) {
+		return false;
+	}
+	struct SiteDef {
+		int32_t level;
+		uint32_t line;
+		std::string module_id, file, function, fmt, tags;
+	};
+	std::vector<SiteDef> sites;
+	std::vector<log_binary::Arg> args;
+	std::string payload;
+	for (;;) {
+		uint32_t header[2];
+		const size_t got = std::fread(header, 1, sizeof(header), in);
+		if (got == 0) {
+			return true;
+		}
+		if (got != sizeof(header) || header[1] > log_binary::max_chunk) {
+			return false;
+		}
+		payload.resize(header[1]);
+		if (std::fread(payload.data(), 1, payload.size(), in) != payload.size()) {
+			return false;
+		}
+		const auto* p = reinterpret_cast<const std::byte*>(payload.data());
+		const auto* end = p + payload.size();
+		auto read_pod = [&](auto& value) {
+			if (static_cast<size_t>(end - p) < sizeof(value)) {
+				return false;
+			}
+			memcpy(&value, p, sizeof(value));
+			p += sizeof(value);
+			return true;
+		};
+		auto read_string = [&](std::string& str) {
+			uint32_t len;
+			if (!read_pod(len) || static_cast<size_t>(end - p) < len) {
+				return false;
+			}
+			str.assign(reinterpret_cast<const char*>(p), len);
+			p += len;
+			return true;
+		};
+		if (header[0] == log_binary::chunk_site) {
+			uint32_t id;
+			SiteDef def;
+			if (!read_pod(id) || !read_pod(def.level) || !read_pod(def.line) || !read_string(def.module_id) ||
+			    !read_string(def.file) || !read_string(def.function) || !read_string(def.fmt) || !read_string(def.tags)) {
+				return false;
+			}
+			def.level = std::clamp(def.level, 0, LOG_LEVEL_TRACE);
+			// 写入端按 0, 1, 2... 的顺序定义调用点, 跳号说明文件损坏
+			if (id > sites.size()) {
+				return false;
+			}
+			if (id == sites.size()) {
+				sites.push_back(std::move(def));
+			} else {
+				sites[id] = std::move(def);
+			}
+		} else if (header[0] == log_binary::chunk_record) {
+			uint64_t tid;
+			uint32_t len, site;
+			int64_t timestamp;
+			if (!read_pod(tid) || !read_pod(len) || !read_pod(site) || !read_pod(timestamp) || site >= sites.size()) {
+				return false;
+			}
+			const SiteDef& def = sites[site];
+			const std::string text =
+			    log_binary::decode_args(def.tags.c_str(), p, end, args) ? log_binary::format_args(def.fmt, args) : "[binary log truncated]";
+			const LogClock::time_point when(std::chrono::duration_cast<LogClock::duration>(std::chrono::nanoseconds(timestamp)));
+			out << "FEWNIDT"[def.level] << ' ' << log_format_timestamp(when) << ' ' << tid << ' ' << def.module_id << ' '
+			    << def.function << ' ' << text << " -- " << def.file << ':' << def.line << '\n';
+		}
+	}
+}
+
+namespace {
+	//! 程序退出时处理完二进制模式缓冲区中剩余的日志
+	struct BinaryFlushAtExit {
+		~BinaryFlushAtExit() { LogBinary_Disable(); }
+	} _binary_flush_at_exit;
 } // namespace
 
+/**
+ * @brief LogStruct 的 JSON 编码: 字段名表在编译期由 reflect::get_member_names 生成, 值直接追加到格式化缓冲区
+ */
+namespace log_struct {
+	template <typename T>
+	struct is_optional : std::false_type {};
+	template <typename T>
+	struct is_optional<std::optional<T>> : std::true_type {};
+
+	/**
+	 * @brief 编译期拼好的 JSON 键: 第 i 个为 {"name": 或 ,"name":
+	 */
+	template <typename T>
+	struct json_keys {
+		static constexpr auto names = reflect::get_member_names<T>();
+		static constexpr size_t total = [] {
+			size_t size = 0;
+			for (auto name : names) {
+				size += name.size() + 4;
+			}
+			return size;
+		}();
+		static constexpr auto offsets = [] {
+			std::array<size_t, names.size() + 1> out{};
+			for (size_t i = 0; i < names.size(); i++) {
+				out[i + 1] = out[i] + names[i].size() + 4;
+			}
+			return out;
+		}();
+		static constexpr auto chars = [] {
+			std::array<char, total + 1> out{};
+			size_t pos = 0;
+			for (size_t i = 0; i < names.size(); i++) {
+				out[pos++] = (i == 0) ? '{' : ',';
+				out[pos++] = '"';
+				for (char ch : names[i]) {
+					out[pos++] = ch;
+				}
+				out[pos++] = '"';
+				out[pos++] = ':';
+			}
+			return out;
+		}();
+		static constexpr std::string_view key(size_t i) { return {chars.data() + offsets[i], offsets[i + 1] - offsets[i]}; }
+	};
+
+	template <typename T>
+	void append_object(std::string& out, const T& obj);
+
+	template <typename T>
+	void append_value(std::string& out, const T& value) {
+		if constexpr (std::is_same_v<T, bool>) {
+			out += value ? "true" : "false";
+		} else if constexpr (std::is_same_v<T, char>) {
+			append_string(out, std::string_view(&value, 1));
+		} else if constexpr (std::is_floating_point_v<T>) {
+			if (!std::isfinite(value)) {
+				out += "null";
+				return;
+			}
+			char buf[32];
+			out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+		} else if constexpr (std::is_integral_v<T>) {
+			char buf[24];
+			out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+		} else if constexpr (std::is_enum_v<T>) {
+			append_value(out, static_cast<std::underlying_type_t<T>>(value));
+		} else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+			//! 值为 nullptr 的 const char* 不能构造 string_view
+			if constexpr (std::is_pointer_v<T>) {
+				if (value == nullptr) {
+					out += "null";
+					return;
+				}
+			}
+			append_string(out, value);
+		} else if constexpr (is_optional<T>::value) {
+			if (value) {
+				append_value(out, *value);
+			} else {
+				out += "null";
+			}
+		} else if constexpr (std::ranges::range<T>) {
+			out += '[';
+			bool first = true;
+			for (const auto& item : value) {
+				if (!first) {
+					out += ',';
+				}
+				first = false;
+				append_value(out, item);
+			}
+			out += ']';
+		} else if constexpr (std::is_aggregate_v<T>) {
+			append_object(out, value);
+		} else {
+			static_assert(!sizeof(T), "unsupported member type for LogStruct");
+		}
+	}
+
+	template <typename T>
+	void append_object(std::string& out, const T& obj) {
+		if constexpr (reflect::members_count_v<T> == 0) {
+			out += "{}";
+		} else {
+			reflect::visit_members(obj, [&out](const auto&... members) {
+				size_t index = 0;
+				((out += json_keys<T>::key(index++), append_value(out, members)), ...);
+			});
+			out += '}';
+		}
+	}
+
+	//! 二进制模式下能直接按参数记录的成员类型
+	template <typename T>
+	inline constexpr bool binary_member_v = std::is_same_v<T, bool> || std::is_integral_v<T> ||
+	                                        std::is_same_v<T, float> || std::is_same_v<T, double> ||
+	                                        std::is_convertible_v<const T&, std::string_view>;
+
+	template <typename T>
+	struct binary_layout;
+	template <typename T>
+	    requires(reflect::members_count_v<T> <= reflect::reflect_max_members)
+	struct binary_layout<T> {
+		using types = decltype(reflect::visit_members(std::declval<const T&>(), [](const auto&... members) {
+			return log_binary::type_list<std::remove_cvref_t<decltype(members)>...>{};
+		}));
+	};
+	template <typename List>
+	struct binary_supported;
+	template <typename... Members>
+	struct binary_supported<log_binary::type_list<Members...>>
+	    : std::bool_constant<(binary_member_v<Members> && ...)> {};
+
+	//! 所有成员都是标量或字符串的聚合类才走二进制模式, 其他的退回文本 JSON
+	template <typename T>
+	inline constexpr bool binary_v = [] {
+		if constexpr (requires { typename binary_layout<T>::types; }) {
+			return binary_supported<typename binary_layout<T>::types>::value;
+		} else {
+			return false;
+		}
+	}();
+
+	/**
+	 * @brief 二进制模式下的格式串, 形如 {{"id":{:j},"name":{:j}}}
+	 * 每个值都用 {:j} 占位, 由 log_binary::format_args 按 JSON 输出, 字符串在后台线程或离线解码时转义
+	 */
+	template <typename T>
+	struct binary_format {
+		static constexpr size_t count = reflect::members_count_v<T>;
+		//! 长度上界, 多余的位置保持为 '\0'
+		static constexpr size_t total = [] {
+			size_t size = 4;
+			for (size_t i = 0; i < count; i++) {
+				size += json_keys<T>::key(i).size() + 5;
+			}
+			return size;
+		}();
+		static constexpr auto chars = [] {
+			std::array<char, total + 1> out{};
+			size_t pos = 0;
+			auto put = [&](std::string_view str) {
+				for (char ch : str) {
+					out[pos++] = ch;
+				}
+			};
+			put(count == 0 ? "{{" : "");
+			for (size_t i = 0; i < count; i++) {
+				put(i == 0 ? "{{" : ",");
+				put(json_keys<T>::key(i).substr(1));
+				put("{:j}");
+			}
+			put("}}");
+			return out;
+		}();
+	};
+} // namespace log_struct
+
+/**
+ * @brief 以 JSON 对象输出聚合类的所有字段, 由 LogStruct 宏调用
+ * @param  module_id   Module Id, 需要在程序运行期间一直有效
+ * @param  location    location
+ * @param  level       Log level
+ * @param  obj         聚合类对象, 成员可以是标量、字符串、optional、容器和嵌套的聚合类
+ */
+template <typename T>
+inline void LogStructFunc(const char* module_id, int level, const std::source_location location, const T& obj) {
+	if (!can_dispatch()) {
+		return;
+	}
+	level = std::clamp(level, 0, LOG_LEVEL_TRACE);
+	const LogClock::time_point now = LogClock::now();
+	TextBuffer buffer;
+	std::string& text = buffer.get();
+	log_struct::append_object(text, obj);
+	log_submit(module_id, level, location, now, text);
+}
+
 // ！ 你可以声明自己的log_output_filterfunc 来过滤 LogContent
 bool __attribute((weak)) log_output_filter(const LogContent* content);
 
@@ -0,0 +1,233 @@
+//! log.hpp 多线程压测: 吞吐、单次调用延迟分位数 (HdrHistogram 式分桶) 和每条日志的内存分配次数
+//! 用法: log_bench [线程数=4] [每线程条数=200000] [文件目录=.] > /dev/null
+//! stdout 通道会输出大量日志, 结果打印到 stderr
+//! mode: sync / async / binary 为 LogInfo 的三种模式; json 为手写 JSON 格式串的 LogInfo, struct / bstruct 为同样字段的 LogStruct 文本 / 二进制模式
+#define LOG_MODULE_ID "bench"
+#include "log.hpp"
+
+#include <bit>
+#include <filesystem>
+#include <functional>
+
+std::atomic<size_t> g_alloc_count{0};
+void*               operator new(size_t n) {
+	g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(n ? n : 1)) {
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+//! 对齐版本也要替换, 否则含 alignas(64) 成员的 AsyncState、ThreadBuffer 等对象的分配不会被计数
+void* operator new(size_t n, std::align_val_t align) {
+	g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+	void* p = nullptr;
+	if (posix_memalign(&p, std::max(static_cast<size_t>(align), sizeof(void*)), n ? n : 1) == 0) {
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace bench {
+	/**
+	 * @brief 对数-线性分桶的延迟直方图: 每个 2 的幂区间再分 8 个子桶, 相对误差不超过 12.5%
+	 */
+	class Histogram {
+	public:
+		void record(uint64_t ns) {
+			_counts[index_of(ns)]++;
+			_total++;
+			_max = std::max(_max, ns);
+		}
+		void merge(const Histogram& other) {
+			for (size_t i = 0; i < _counts.size(); i++) {
+				_counts[i] += other._counts[i];
+			}
+			_total += other._total;
+			_max = std::max(_max, other._max);
+		}
+		//! 返回分位数所在桶的上界
+		uint64_t percentile(double p) const {
+			const auto target = static_cast<uint64_t>(p * static_cast<double>(_total));
+			uint64_t seen = 0;
+			for (size_t i = 0; i < _counts.size(); i++) {
+				seen += _counts[i];
+				if (seen > target) {
+					return std::min(upper_of(i), _max);
+				}
+			}
+			return _max;
+		}
+		uint64_t max() const { return _max; }
+
+	private:
+		static size_t index_of(uint64_t v) {
+			if (v < 16) {
+				return v;
+			}
+			const int msb = std::bit_width(v) - 1;
+			return 16 + static_cast<size_t>(msb - 4) * 8 + ((v >> (msb - 3)) - 8);
+		}
+		static uint64_t upper_of(size_t i) {
+			if (i < 16) {
+				return i;
+			}
+			const size_t msb = (i - 16) / 8 + 4;
+			const uint64_t sub = (i - 16) % 8 + 8;
+			return ((sub + 1) << (msb - 3)) - 1;
+		}
+
+		std::array<uint64_t, 16 + 60 * 8> _counts{};
+		uint64_t _total = 0;
+		uint64_t _max = 0;
+	};
+
+	struct Result {
+		std::string mode;
+		std::string channel;
+		size_t threads;
+		size_t messages;
+		double seconds;
+		Histogram latency;
+		double allocs_per_msg;
+	};
+
+	//! 典型参数组合: 整数、字符串、浮点
+	const std::string g_user = "user-1234";
+	inline void log_sync(size_t i) { LogInfo("request {} from {} took {} ms", i, g_user, 1.25); }
+	inline void log_deferred(size_t i) {
+		LOG_LEVEL_ENABLED(LOG_LEVEL_INFO) ? LogBinaryPrintf(LOG_LEVEL_INFO, "request {} from {} took {} ms", i, g_user, 1.25)
+		                                 : void();
+	}
+	//! 同样三个字段用 LogStruct 输出为 JSON, 与手写 JSON 格式串的 LogInfo 对比 (后者不转义字符串)
+	struct Request {
+		size_t id;
+		const char* user;
+		double ms;
+	};
+	inline void log_struct_sync(size_t i) { LogStruct(LOG_LEVEL_INFO, (Request{i, g_user.c_str(), 1.25})); }
+	inline void log_struct_deferred(size_t i) {
+		LOG_LEVEL_ENABLED(LOG_LEVEL_INFO) ? LogBinaryStruct(LOG_LEVEL_INFO, (Request{i, g_user.c_str(), 1.25})) : void();
+	}
+	inline void log_json_sync(size_t i) { LogInfo("{{\"id\":{},\"user\":\"{}\",\"ms\":{}}}", i, g_user, 1.25); }
+
+	/**
+	 * @brief threads 个线程各打印 per_thread 条, 计时到 finish() 返回 (异步模式下包含排空队列)
+	 */
+	Result run(std::string mode, std::string channel, size_t threads, size_t per_thread, void (*log)(size_t),
+	           const std::function<void()>& finish) {
+		Result r{.mode = std::move(mode),
+		         .channel = std::move(channel),
+		         .threads = threads,
+		         .messages = threads * per_thread,
+		         .seconds = 0,
+		         .latency = {},
+		         .allocs_per_msg = 0};
+		std::vector<Histogram> histograms(threads);
+		std::vector<std::thread> workers;
+		std::atomic<size_t> ready{0};
+		std::atomic<bool> go{false};
+		for (size_t t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+				Histogram& h = histograms[t];
+				ready++;
+				while (!go.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+				for (size_t i = 0; i < per_thread; i++) {
+					const auto t0 = std::chrono::steady_clock::now();
+					log(i);
+					const auto t1 = std::chrono::steady_clock::now();
+					h.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+				}
+			});
+		}
+		while (ready.load() != threads) {
+			std::this_thread::yield();
+		}
+		const size_t allocs = g_alloc_count.load();
+		const auto begin = std::chrono::steady_clock::now();
+		go.store(true, std::memory_order_release);
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		finish();
+		const auto end = std::chrono::steady_clock::now();
+		r.allocs_per_msg = static_cast<double>(g_alloc_count.load() - allocs) / static_cast<double>(r.messages);
+		r.seconds = std::chrono::duration<double>(end - begin).count();
+		for (const auto& h : histograms) {
+			r.latency.merge(h);
+		}
+		return r;
+	}
+
+	void print(const Result& r) {
+		std::cerr << std::format("{:<7} {:<7} {:>3} {:>12.0f} {:>8} {:>8} {:>8} {:>10} {:>8.2f}\n", r.mode, r.channel, r.threads,
+		                         static_cast<double>(r.messages) / r.seconds, r.latency.percentile(0.5),
+		                         r.latency.percentile(0.99), r.latency.percentile(0.999), r.latency.max(), r.allocs_per_msg);
+	}
+
+	void run_all(size_t threads, size_t per_thread, const std::filesystem::path& dir) {
+		const std::string text_file = (dir / "log_bench.log").string();
+		const std::string binary_file = (dir / "log_bench.bin").string();
+		auto nothing = [] {};
+		auto null_channel = [](const LogContent*, void*) {};
+		std::vector<Result> results;
+
+		{
+			const uint32_t id = log_add_print_func(null_channel, nullptr);
+			results.push_back(run("sync", "null", threads, per_thread, log_sync, nothing));
+			LogAsync_Enable(1 << 16);
+			results.push_back(run("async", "null", threads, per_thread, log_sync, LogAsync_Disable));
+			LogBinary_Enable();
+			results.push_back(run("binary", "null", threads, per_thread, log_deferred, LogBinary_Disable));
+			results.push_back(run("json", "null", threads, per_thread, log_json_sync, nothing));
+			results.push_back(run("struct", "null", threads, per_thread, log_struct_sync, nothing));
+			LogBinary_Enable();
+			results.push_back(run("bstruct", "null", threads, per_thread, log_struct_deferred, LogBinary_Disable));
+			log_remove_print_func(id);
+		}
+		{
+			LogFileSink sink(LogFileOptions{.path = text_file});
+			results.push_back(run("sync", "file", threads, per_thread, log_sync, [&] { sink.flush(); }));
+			LogAsync_Enable(1 << 16);
+			results.push_back(run("async", "file", threads, per_thread, log_sync, [&] {
+				LogAsync_Disable();
+				sink.flush();
+			}));
+		}
+		{
+			LogBinary_Enable(binary_file.c_str());
+			results.push_back(run("binary", "file", threads, per_thread, log_deferred, LogBinary_Disable));
+		}
+		{
+			LogOutput_Enable();
+			results.push_back(run("sync", "stdout", threads, per_thread, log_sync, [] { std::cout.flush(); }));
+			LogAsync_Enable(1 << 16);
+			results.push_back(run("async", "stdout", threads, per_thread, log_sync, [] {
+				LogAsync_Disable();
+				std::cout.flush();
+			}));
+			LogOutput_Disable();
+		}
+		std::filesystem::remove(text_file);
+		std::filesystem::remove(binary_file);
+
+		std::cerr << std::format("{:<7} {:<7} {:>3} {:>12} {:>8} {:>8} {:>8} {:>10} {:>8}\n", "mode", "channel", "thr",
+		                         "msgs/s", "p50(ns)", "p99(ns)", "p99.9(ns)", "max(ns)", "allocs");
+		for (const auto& r : results) {
+			print(r);
+		}
+	}
+} // namespace bench
+
+int main(int argc, char** argv) {
+	const size_t threads = (argc > 1) ? std::stoul(argv[1]) : 4;
+	const size_t per_thread = (argc > 2) ? std::stoul(argv[2]) : 200000;
+	const std::filesystem::path dir = (argc > 3) ? argv[3] : ".";
+	bench::run_all(threads, per_thread, dir);
+	return 0;
+}
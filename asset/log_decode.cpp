@@ -0,0 +1,23 @@
+//! 解码 LogBinary_Enable(path) 写出的二进制日志文件
+//! 用法: log_decode <file>
+#define LOG_MODULE_ID "log_decode"
+#include "log.hpp"
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <binary log file>" << std::endl;
+		return -1;
+	}
+	std::FILE* in = std::fopen(argv[1], "rb");
+	if (in == nullptr) {
+		std::cerr << std::format("open {} failed: {}", argv[1], strerror(errno)) << std::endl;
+		return -1;
+	}
+	const bool ok = log_binary_decode(in, std::cout);
+	std::fclose(in);
+	if (!ok) {
+		std::cerr << "corrupted or truncated log file" << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,16 @@
+//! 导出 LogFlightRecorder 写下的环形日志文件, 从旧到新每条一行
+//! 用法: log_flight_dump <file>
+#define LOG_MODULE_ID "log_flight_dump"
+#include "log.hpp"
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <flight recorder file>" << std::endl;
+		return -1;
+	}
+	if (!log_flight_dump(argv[1], std::cout)) {
+		std::cerr << std::format("{} is not a readable flight recorder file", argv[1]) << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -6,229 +6,37 @@
 #include <type_traits>
 #include <utility>
 
+#include "reflect.hpp"
+
+using namespace reflect;
+
 struct Person {
     int         id____;
     std::string name____;
 };
 
-struct Any {
-    template <class T>
-    operator T(); // 重载了类型转化运算符
-};
-
-/*
-首先利用聚合初始化 sfiane 出成员个数，
-然后结构化绑定拿到成员，
-通过模板函数的 __PRETTY_FUNCTION 拿到成员名字。
-*/
-
-/**
- * @brief 编译期静态递归计算结构体成员个数
- *
- * @tparam T
- * @tparam Args
- * @return 结构体成员个数
- */
-template <class T, class... Args>
-consteval auto member_count() {
-    // consteval 是C++20 的强制编译期执行操作, 如果编译期没有执行则会报错
-    /**
-     * 如果模版 T {Args{}..., Any{}} 不能被实例化, 说明 T 的成员参数个数 ==
-     * sizeof...(Args)
-     */
-    if constexpr (requires { T{{Args{}}..., {Any{}}}; } == false) {
-        return sizeof...(Args);
-    } else {
-        // 如果可以实例化, 则添加一个参数
-        return member_count<T, Args..., Any>();
-    }
-}
-
-/*
-对于 Person, 是实例化为: (GCC)
-目前问题是, 为什么可以出现 & wrapper<Person>::value.Person::id 这种展示到成员名称的, 成员指针?!
-
-constexpr std::string_view get_member_name() [
-    with auto ptr = Wrapper<int*>{
-        (& wrapper<Person>::value.Person::id)}; 
-        std::string_view = std::basic_string_view<char>],
-
-constexpr std::string_view get_member_name() [
-    with auto ptr = Wrapper<std::__cxx11::basic_string<char>*>{
-        (& wrapper<Person>::value.Person::name)}; 
-        std::string_view = std::basic_string_view<char>], 
-*/
-
-template <auto ptr>
-inline constexpr std::string_view get_member_name() {
-#if defined(_MSC_VER)
-    constexpr std::string_view func_name = __FUNCSIG__;
-#else
-    constexpr std::string_view func_name = __PRETTY_FUNCTION__;
-#endif
-
-#if defined(__clang__)
-    auto split = func_name.substr(0, func_name.size() - 2);
-    return split.substr(split.find_last_of(":.") + 1);
-#elif defined(__GNUC__)
-    auto split = func_name.substr(0, func_name.rfind(")}"));
-    return split.substr(split.find_last_of(":") + 1);
-#elif defined(_MSC_VER)
-    auto split = func_name.substr(0, func_name.rfind("}>"));
-    return split.substr(split.rfind("->") + 2);
-#else
-    static_assert(false, "You are using an unsupported compiler. Please use GCC, Clang "
-                         "or MSVC or switch to the rfl::Field-syntax.");
-#endif
-}
-
-template <typename T>
-constexpr std::size_t members_count_v = member_count<T>();
-
-template <class T>
-struct Wrapper {
-    using Type = T;
-    T v;
-};
-
-template <class T>
-Wrapper(T) -> Wrapper<T>;
-
-// This workaround is necessary for clang.
-// 此解决方法对于clang是必要的
-template <class T>
-inline constexpr auto wrap(const T& arg) noexcept {
-    return Wrapper{arg};
-}
-
-template <class T, std::size_t n>
-struct object_tuple_view_helper {
-    static constexpr auto tuple_view() {
-        static_assert(sizeof(T) < 0, "\n\nThis error occurs for one of two reasons:\n\n"
-                                     "1) You have created a struct with more than 100 fields, which is "
-                                     "unsupported. \n\n"
-                                     "2) Your struct is not an aggregate type.\n\n");
-    }
-
-    static constexpr auto tuple_view(T&) {
-        static_assert(sizeof(T) < 0, "\n\nThis error occurs for one of two reasons:\n\n"
-                                     "1) You have created a struct with more than 100 fields, which is "
-                                     "unsupported. \n\n"
-                                     "2) Your struct is not an aggregate type.\n\n");
-    }
-
-    template <typename Visitor>
-    static constexpr decltype(auto) tuple_view(T&&, Visitor&&) {
-        static_assert(sizeof(T) < 0, "\n\nThis error occurs for one of two reasons:\n\n"
-                                     "1) You have created a struct with more than 100 fields, which is "
-                                     "unsupported. \n\n"
-                                     "2) Your struct is not an aggregate type.\n\n");
-    }
-};
-
-template <class T>
-struct object_tuple_view_helper<T, 0> {
-    static constexpr auto tuple_view() {
-        return std::tie();
-    }
-
-    static constexpr auto tuple_view(T&) {
-        return std::tie();
-    }
+// 按名字访问的边界情况: 没有成员、只有一个成员、多种类型混合
+struct NoMember {};
 
-    template <typename Visitor>
-    static constexpr decltype(auto) tuple_view(T&&, Visitor&&) {}
+struct OneMember {
+    int only;
 };
 
-/**
- * @brief 去掉 T 的 &、&&、const、volatile
- * @tparam T
- */
-template <typename T>
-using remove_cvref_t = std::remove_cv_t<std::remove_reference_t<T>>;
-
-template <class T>
-struct wrapper {
-    static inline remove_cvref_t<T> value{};
+struct Mixed {
+    int         id;
+    double      score;
+    char        grade;
+    std::string name;
 };
 
-/**
- * @brief 获取 T 类型的全局静态引用
- * @tparam T 
- * @return constexpr remove_cvref_t<T>& 
- */
-template <class T>
-inline constexpr remove_cvref_t<T>& get_fake_object() noexcept {
-    return wrapper<remove_cvref_t<T>>::value;
-}
-
-// 此处的 T = Person
-#define RFL_INTERNAL_OBJECT_IF_YOU_SEE_AN_ERROR_REFER_TO_DOCUMENTATION_ON_C_ARRAYS(n, ...)                                                                                         \
-    template <class T>                                                                                                                                                             \
-    struct object_tuple_view_helper<T, n> {                                                                                                                                        \
-        static constexpr auto tuple_view() {                                                                                                                                       \
-            (void)"// 获取 T也就是struct的全局静态引用, 然后将其 成员变量 结构化绑定 到__VA_ARGS__";                                                                               \
-            auto& [__VA_ARGS__] = get_fake_object<remove_cvref_t<T>>();                                                                                                            \
-            (void)"// 然后使用 tie 将他们按照左值引用, 绑定为 tuple";                                                                                                              \
-            auto ref_tup  = std::tie(__VA_ARGS__);                                                                                                                                 \
-            auto get_ptrs = [](auto&... _refs) { return std::make_tuple(&_refs...); };                                                                                             \
-            (void)"// 然后调用函数, 以展开, 并且取地址 也就是 成员指针?! (返回是tuple<成员指针...>)";                                                                              \
-            return std::apply(get_ptrs, ref_tup);                                                                                                                                  \
-        }                                                                                                                                                                          \
-    }
-
-#include "member_macro.hpp"
-
-template <class T>
-inline constexpr auto struct_to_tuple() {
-    return object_tuple_view_helper<T, members_count_v<T>>::tuple_view();
-}
-
-template <typename T, typename U, size_t... Is>
-inline constexpr void init_arr_with_tuple(U& arr, std::index_sequence<Is...>) {
-    constexpr auto tp = struct_to_tuple<T>();
-    ((arr[Is] = get_member_name<wrap(std::get<Is>(tp))>()), ...);
-}
-
-template <typename T>
-inline constexpr std::array<std::string_view, members_count_v<T>> _get_member_names() {
-    constexpr size_t                    Count = members_count_v<T>;
-    std::array<std::string_view, Count> arr;
-    // 得到 tuple<成员指针...>
-    constexpr auto tp = struct_to_tuple<T>();
-
-    // 使用魔法, 遍历每一个成员指针 以实例化模版, to 成员名称, 然后保存到 arr里面
-    [&]<size_t... Is>(std::index_sequence<Is...>) mutable { ((arr[Is] = get_member_name<wrap(std::get<Is>(tp))>()), ...); }(std::make_index_sequence<Count>{});
+static_assert(member_index_by_name<NoMember>("") == member_npos);
+static_assert(member_index_by_name<NoMember>("only") == member_npos);
+static_assert(member_index_by_name<OneMember>("only") == 0);
+static_assert(member_index_by_name<OneMember>("") == member_npos);
+static_assert(member_index_by_name<OneMember>("onl") == member_npos);
+static_assert(member_index_by_name<Mixed>("") == member_npos);
+static_assert(member_index_by_name<Mixed>("ids") == member_npos);
 
-    return arr;
-}
-
-template <typename T>
-inline constexpr std::array<std::string_view, members_count_v<T>> get_member_names() {
-    auto arr = _get_member_names<T>();
-    return arr;
-}
-
-constexpr decltype(auto) visit_members(auto&& obj, auto&& visitor) {
-    // 去除引用, 获取实际类型
-    using ObjType      = std::remove_cv_t<std::remove_reference_t<decltype(obj)>>;
-    constexpr auto Cnt = member_count<ObjType>();
-
-    // 用宏实现!, 见上面
-    if constexpr (Cnt == 0) {
-        return visitor();
-    } else if constexpr (Cnt == 1) {
-        auto&& [a1] = obj;
-        return visitor(a1);
-    } else if constexpr (Cnt == 2) {
-        auto&& [a1, a2] = obj;
-        return visitor(a1, a2);
-    } else if constexpr (Cnt == 3) {
-        auto&& [a1, a2, a3] = obj;
-        return visitor(a1, a2, a3);
-    } // ...
-    throw;
-}
 
 template <class T>
 inline constexpr std::string getName() {
@@ -319,6 +127,62 @@ int main() {
     }
     std::cout << "\n";
 
+    {
+        std::cout << "\n================ 按名字读写 ================\n";
+        int  failed = 0;
+        auto check  = [&failed](bool ok, std::string_view what) {
+            if (!ok) {
+                std::cout << "FAILED: " << what << '\n';
+                ++failed;
+            }
+        };
+
+        // 所有成员名都能查回自己的下标
+        constexpr auto names = get_member_names<Mixed>();
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            check(member_index_by_name<Mixed>(names[i]) == i, names[i]);
+        }
+
+        // 类型完全相同时写入再读出
+        Mixed m{};
+        check(set_member_by_name(m, "id", 7), "set id");
+        check(set_member_by_name(m, "score", 2.5), "set score");
+        check(set_member_by_name(m, "grade", 'B'), "set grade");
+        check(set_member_by_name(m, "name", std::string("alice")), "set name");
+        int         id    = 0;
+        double      score = 0;
+        char        grade = 0;
+        std::string name;
+        check(get_member_by_name(m, "id", id) && id == 7, "get id");
+        check(get_member_by_name(m, "score", score) && score == 2.5, "get score");
+        check(get_member_by_name(m, "grade", grade) && grade == 'B', "get grade");
+        check(get_member_by_name(m, "name", name) && name == "alice", "get name");
+
+        // 类型不同一律拒绝, 成员和输出都保持原值
+        check(!set_member_by_name(m, "name", 65) && m.name == "alice", "reject int -> string");
+        check(!set_member_by_name(m, "id", 3.9) && m.id == 7, "reject double -> int");
+        check(!set_member_by_name(m, "name", "bob") && m.name == "alice", "reject literal -> string");
+        check(!get_member_by_name(m, "grade", name) && name == "alice", "reject char -> string");
+        check(!get_member_by_name(m, "score", id) && id == 7, "reject double -> int");
+
+        // 不存在的名字和空名字
+        check(!set_member_by_name(m, "", 1), "set empty name");
+        check(!set_member_by_name(m, "nope", 1), "set unknown name");
+        check(!get_member_by_name(m, "", id), "get empty name");
+
+        // 没有成员、只有一个成员
+        NoMember none{};
+        check(!set_member_by_name(none, "", 1) && !get_member_by_name(none, "only", id), "no member");
+        OneMember one{};
+        check(set_member_by_name(one, "only", 42) && get_member_by_name(one, "only", id) && id == 42, "one member");
+        check(!set_member_by_name(one, "", 1) && one.only == 42, "one member empty name");
+
+        std::cout << (failed == 0 ? "all passed" : "some checks failed") << '\n';
+        if (failed != 0) {
+            return 1;
+        }
+    }
+
     // Person p3 {Any{}, Any{}, Any{}}; // 报错
 
     // 可以使用静态模版for 展开, 以得到正确的 这个数量
@@ -0,0 +1,507 @@
+//! reflect.hpp
+#ifndef REFLECT_HPP
+#define REFLECT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+//! 反射工具都在 reflect 命名空间中, 被 log.hpp 等头文件包含时不污染全局命名空间
+namespace reflect {
+
+    struct Any {
+        template <class T>
+        operator T(); // 重载了类型转化运算符
+    };
+
+    /*
+    首先利用聚合初始化 sfiane 出成员个数，
+    然后结构化绑定拿到成员，
+    通过模板函数的 __PRETTY_FUNCTION 拿到成员名字。
+    */
+
+    //! member_macro.hpp 生成的结构化绑定展开上限, 也是 visit_members / struct_to_tuple 支持的最大成员个数
+    inline constexpr std::size_t reflect_max_members = 128;
+
+    /**
+     * @brief 判断 T 能否用 sizeof...(Is) 个 {Any{}} 聚合初始化
+     *
+     * 每个初始化器都带一层花括号, 避免数组、嵌套聚合类成员被花括号省略拆成多个
+     */
+    template <class T, std::size_t... Is>
+    consteval bool _member_count_constructible(std::index_sequence<Is...>) {
+        return requires { T{{(static_cast<void>(Is), Any{})}...}; };
+    }
+
+    /**
+     * @brief 在 [Lo, Hi) 中二分查找: 已知 Lo 个参数可以初始化, Hi 个不行
+     */
+    template <class T, std::size_t Lo, std::size_t Hi>
+    consteval std::size_t _member_count_search() {
+        if constexpr (Hi - Lo <= 1) {
+            return Lo;
+        } else {
+            constexpr std::size_t Mid = Lo + (Hi - Lo) / 2;
+            if constexpr (_member_count_constructible<T>(std::make_index_sequence<Mid>{})) {
+                return _member_count_search<T, Mid, Hi>();
+            } else {
+                return _member_count_search<T, Lo, Mid>();
+            }
+        }
+    }
+
+    /**
+     * @brief 倍增找到第一个不能初始化的参数个数 N, 再在 [N / 2, N) 中二分
+     */
+    template <class T, std::size_t N>
+    consteval std::size_t _member_count_gallop() {
+        if constexpr (_member_count_constructible<T>(std::make_index_sequence<N>{})) {
+            return _member_count_gallop<T, N * 2>();
+        } else {
+            return _member_count_search<T, N / 2, N>();
+        }
+    }
+
+    /**
+     * @brief 编译期计算结构体成员个数
+     *
+     * 聚合初始化允许少给初始化器, 所以 "能用 n 个参数初始化" 对 n 是单调的,
+     * 倍增 + 二分只需要 O(log n) 次实例化 (逐个加参数的递归需要 n 次, 且每次的参数包都在变长)
+     *
+     * @tparam T
+     * @return 结构体成员个数
+     */
+    template <class T>
+    consteval std::size_t member_count() {
+        // consteval 是C++20 的强制编译期执行操作, 如果编译期没有执行则会报错
+        return _member_count_gallop<T, 1>();
+    }
+
+    template <typename T>
+    constexpr std::size_t members_count_v = member_count<T>();
+
+    /*
+    对于 Person, 是实例化为: (GCC)
+    目前问题是, 为什么可以出现 & wrapper<Person>::value.Person::id 这种展示到成员名称的, 成员指针?!
+
+    constexpr std::string_view get_member_name() [
+        with auto ptr = Wrapper<int*>{
+            (& wrapper<Person>::value.Person::id)}; 
+            std::string_view = std::basic_string_view<char>],
+
+    constexpr std::string_view get_member_name() [
+        with auto ptr = Wrapper<std::__cxx11::basic_string<char>*>{
+            (& wrapper<Person>::value.Person::name)}; 
+            std::string_view = std::basic_string_view<char>], 
+    */
+
+    template <auto ptr>
+    inline constexpr std::string_view get_member_name() {
+#if defined(_MSC_VER)
+        constexpr std::string_view func_name = __FUNCSIG__;
+#else
+        constexpr std::string_view func_name = __PRETTY_FUNCTION__;
+#endif
+
+#if defined(__clang__)
+        auto split = func_name.substr(0, func_name.size() - 2);
+        return split.substr(split.find_last_of(":.") + 1);
+#elif defined(__GNUC__)
+        auto split = func_name.substr(0, func_name.rfind(")}"));
+        return split.substr(split.find_last_of(":") + 1);
+#elif defined(_MSC_VER)
+        auto split = func_name.substr(0, func_name.rfind("}>"));
+        return split.substr(split.rfind("->") + 2);
+#else
+        static_assert(false, "You are using an unsupported compiler. Please use GCC, Clang "
+                             "or MSVC or switch to the rfl::Field-syntax.");
+#endif
+    }
+
+    template <class T>
+    struct Wrapper {
+        using Type = T;
+        T v;
+    };
+
+    template <class T>
+    Wrapper(T) -> Wrapper<T>;
+
+    // This workaround is necessary for clang.
+    // 此解决方法对于clang是必要的
+    template <class T>
+    inline constexpr auto wrap(const T& arg) noexcept {
+        return Wrapper{arg};
+    }
+
+    /**
+     * @brief 成员指针表: 每个下标一个基类, 按下标取值只需一次重载决议
+     *
+     * std::tuple 是逐层递归继承, 上百个成员时 make_tuple / std::get 的实例化开销是平方级的
+     */
+    template <std::size_t I, class T>
+    struct member_ptr_leaf {
+        T ptr;
+    };
+
+    template <class Seq, class... Ts>
+    struct member_ptr_table;
+
+    template <std::size_t... Is, class... Ts>
+    struct member_ptr_table<std::index_sequence<Is...>, Ts...> : member_ptr_leaf<Is, Ts>... {};
+
+    template <class... Ts>
+    inline constexpr auto make_member_ptr_table(Ts... ptrs) {
+        return member_ptr_table<std::index_sequence_for<Ts...>, Ts...>{{ptrs}...};
+    }
+
+    /**
+     * @brief 取成员指针表的第 I 项, 由基类 member_ptr_leaf<I, T> 推导出 T
+     */
+    template <std::size_t I, class T>
+    inline constexpr T get_member_ptr(const member_ptr_leaf<I, T>& leaf) noexcept {
+        return leaf.ptr;
+    }
+
+    template <class T, std::size_t n>
+    struct object_tuple_view_helper {
+        static constexpr auto tuple_view() {
+            static_assert(sizeof(T) < 0, "\n\nThis error occurs for one of two reasons:\n\n"
+                                         "1) You have created a struct with more than 128 fields, which is "
+                                         "unsupported. \n\n"
+                                         "2) Your struct is not an aggregate type.\n\n");
+        }
+
+        static constexpr auto tuple_view(T&) {
+            static_assert(sizeof(T) < 0, "\n\nThis error occurs for one of two reasons:\n\n"
+                                         "1) You have created a struct with more than 128 fields, which is "
+                                         "unsupported. \n\n"
+                                         "2) Your struct is not an aggregate type.\n\n");
+        }
+
+        template <typename Visitor>
+        static constexpr decltype(auto) tuple_view(auto&&, Visitor&&) {
+            static_assert(sizeof(T) < 0, "\n\nThis error occurs for one of two reasons:\n\n"
+                                         "1) You have created a struct with more than 128 fields, which is "
+                                         "unsupported. \n\n"
+                                         "2) Your struct is not an aggregate type.\n\n");
+        }
+    };
+
+    template <class T>
+    struct object_tuple_view_helper<T, 0> {
+        static constexpr auto tuple_view() {
+            return make_member_ptr_table();
+        }
+
+        static constexpr auto tuple_view(T&) {
+            return std::tie();
+        }
+
+        template <typename Visitor>
+        static constexpr decltype(auto) tuple_view(auto&&, Visitor&& visitor) {
+            return visitor();
+        }
+    };
+
+    /**
+     * @brief 去掉 T 的 &、&&、const、volatile
+     * @tparam T
+     */
+    template <typename T>
+    using remove_cvref_t = std::remove_cv_t<std::remove_reference_t<T>>;
+
+    template <class T>
+    struct wrapper {
+        static inline remove_cvref_t<T> value{};
+    };
+
+    /**
+     * @brief 获取 T 类型的全局静态引用
+     * @tparam T 
+     * @return constexpr remove_cvref_t<T>& 
+     */
+    template <class T>
+    inline constexpr remove_cvref_t<T>& get_fake_object() noexcept {
+        return wrapper<remove_cvref_t<T>>::value;
+    }
+
+    // 此处的 T = Person
+    // tuple_view() 返回 member_ptr_table<成员指针...>; tuple_view(obj, visitor) 对实际对象做同样的结构化绑定, 把成员按顺序交给 visitor
+#define RFL_INTERNAL_OBJECT_IF_YOU_SEE_AN_ERROR_REFER_TO_DOCUMENTATION_ON_C_ARRAYS(n, ...)                                                                                         \
+        template <class T>                                                                                                                                                             \
+        struct object_tuple_view_helper<T, n> {                                                                                                                                        \
+            static constexpr auto tuple_view() {                                                                                                                                       \
+                (void)"// 获取 T也就是struct的全局静态引用, 然后将其 成员变量 结构化绑定 到__VA_ARGS__";                                                                               \
+                auto& [__VA_ARGS__] = get_fake_object<remove_cvref_t<T>>();                                                                                                            \
+                (void)"// 然后对每个成员取地址, 也就是 成员指针?! (返回是 member_ptr_table<成员指针...>)";                                                                             \
+                return [](auto&... _refs) { return make_member_ptr_table(&_refs...); }(__VA_ARGS__);                                                                                   \
+            }                                                                                                                                                                          \
+                                                                                                                                                                                       \
+            template <typename Visitor>                                                                                                                                                \
+            static constexpr decltype(auto) tuple_view(auto&& obj, Visitor&& visitor) {                                                                                                \
+                auto&& [__VA_ARGS__] = obj;                                                                                                                                            \
+                return visitor(__VA_ARGS__);                                                                                                                                           \
+            }                                                                                                                                                                          \
+        }
+
+#include "member_macro.hpp"
+
+    /**
+     * @brief 依次把 obj 的每个成员 (保持 const 和引用) 传给 visitor
+     *
+     * 按成员个数分派到 member_macro.hpp 生成的结构化绑定, 支持 0 ~ reflect_max_members 个成员
+     */
+    constexpr decltype(auto) visit_members(auto&& obj, auto&& visitor) {
+        // 去除引用, 获取实际类型
+        using ObjType      = remove_cvref_t<decltype(obj)>;
+        constexpr auto Cnt = member_count<ObjType>();
+        return object_tuple_view_helper<ObjType, Cnt>::tuple_view(obj, visitor);
+    }
+
+    template <class T>
+    inline constexpr auto struct_to_tuple() {
+        return object_tuple_view_helper<T, members_count_v<T>>::tuple_view();
+    }
+
+    template <typename T, typename U, size_t... Is>
+    inline constexpr void init_arr_with_tuple(U& arr, std::index_sequence<Is...>) {
+        constexpr auto tp = struct_to_tuple<T>();
+        ((arr[Is] = get_member_name<wrap(get_member_ptr<Is>(tp))>()), ...);
+    }
+
+    template <typename T>
+    inline constexpr std::array<std::string_view, members_count_v<T>> _get_member_names() {
+        constexpr size_t                    Count = members_count_v<T>;
+        std::array<std::string_view, Count> arr;
+        // 得到 member_ptr_table<成员指针...>
+        constexpr auto tp = struct_to_tuple<T>();
+
+        // 使用魔法, 遍历每一个成员指针 以实例化模版, to 成员名称, 然后保存到 arr里面
+        [&]<size_t... Is>(std::index_sequence<Is...>) mutable { ((arr[Is] = get_member_name<wrap(get_member_ptr<Is>(tp))>()), ...); }(std::make_index_sequence<Count>{});
+
+        return arr;
+    }
+
+    template <typename T>
+    inline constexpr std::array<std::string_view, members_count_v<T>> get_member_names() {
+        auto arr = _get_member_names<T>();
+        return arr;
+    }
+
+    /*
+    按名字访问成员: 编译期为每个类型生成一张最小完美哈希表 (hash and displace),
+    名字 -> 桶 -> 桶的种子 -> 槽 -> 成员下标, 再比较一次名字排除不存在的字段;
+    成员下标 -> 成员 走编译期生成的函数指针跳转表. 两张表都是 constexpr 常量, 没有运行期初始化
+    */
+
+    //! 按名字找不到成员时返回的下标
+    inline constexpr std::size_t member_npos = static_cast<std::size_t>(-1);
+
+    /**
+     * @brief 带种子的 FNV-1a, 末尾再混合一次, 让不同种子取模后的低位也足够分散
+     */
+    inline constexpr uint32_t member_name_hash(std::string_view name, uint32_t seed) noexcept {
+        uint32_t h = 2166136261u ^ seed;
+        for (char c : name) {
+            h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        return h;
+    }
+
+    /**
+     * @brief N 个名字、N 个桶、N 个槽的最小完美哈希表
+     * @tparam N 成员个数
+     */
+    template <std::size_t N>
+    struct member_name_table {
+        std::array<int32_t, N>          seeds{};   // 每个桶的种子; 负数表示桶里只有一个名字, 直接放在槽 -seed - 1
+        std::array<uint8_t, N>          indices{}; // 槽 -> 成员下标
+        std::array<std::string_view, N> names{};   // 槽 -> 成员名字, 用于排除不存在的字段
+
+        /**
+         * @brief 名字 -> 成员下标, 两次哈希加一次比较
+         * @return 成员下标, 不存在时返回 member_npos
+         */
+        constexpr std::size_t find(std::string_view name) const noexcept {
+            if constexpr (N == 0) {
+                return member_npos;
+            } else {
+                const int32_t     seed = seeds[member_name_hash(name, 0) % N];
+                const std::size_t slot = seed < 0 ? static_cast<std::size_t>(-seed - 1) : member_name_hash(name, static_cast<uint32_t>(seed)) % N;
+                return names[slot] == name ? indices[slot] : member_npos;
+            }
+        }
+    };
+
+    /**
+     * @brief 编译期构造完美哈希表
+     *
+     * 名字先按种子 0 分到 N 个桶, 从大桶到小桶依次为每个桶找一个种子, 使桶内名字落到互不相同的空槽;
+     * 只有一个名字的桶最后直接分配剩下的空槽. 名字互不相同时一定能构造成功
+     */
+    template <std::size_t N>
+    inline constexpr member_name_table<N> make_member_name_table(const std::array<std::string_view, N>& names) {
+        static_assert(N <= 256, "member index must fit in uint8_t");
+        member_name_table<N>       table{};
+        std::array<std::size_t, N> bucket_of{};
+        std::array<std::size_t, N> bucket_size{};
+        std::array<bool, N>        used{};
+        std::size_t                max_size = 0;
+        for (std::size_t i = 0; i < N; ++i) {
+            bucket_of[i] = member_name_hash(names[i], 0) % N;
+            max_size     = std::max(max_size, ++bucket_size[bucket_of[i]]);
+        }
+
+        auto place = [&](std::size_t slot, std::size_t index) {
+            used[slot]          = true;
+            table.indices[slot] = static_cast<uint8_t>(index);
+            table.names[slot]   = names[index];
+        };
+
+        for (std::size_t size = max_size; size >= 2; --size) {
+            for (std::size_t b = 0; b < N; ++b) {
+                if (bucket_size[b] != size) {
+                    continue;
+                }
+                std::array<std::size_t, N> keys{};
+                std::size_t                count = 0;
+                for (std::size_t i = 0; i < N; ++i) {
+                    if (bucket_of[i] == b) {
+                        keys[count++] = i;
+                    }
+                }
+                for (uint32_t seed = 1;; ++seed) {
+                    std::array<std::size_t, N> slots{};
+                    bool                       ok = true;
+                    for (std::size_t j = 0; ok && j < count; ++j) {
+                        slots[j] = member_name_hash(names[keys[j]], seed) % N;
+                        ok       = !used[slots[j]];
+                        for (std::size_t k = 0; ok && k < j; ++k) {
+                            ok = slots[k] != slots[j];
+                        }
+                    }
+                    if (ok) {
+                        table.seeds[b] = static_cast<int32_t>(seed);
+                        for (std::size_t j = 0; j < count; ++j) {
+                            place(slots[j], keys[j]);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::size_t free_slot = 0;
+        for (std::size_t i = 0; i < N; ++i) {
+            if (bucket_size[bucket_of[i]] != 1) {
+                continue;
+            }
+            while (used[free_slot]) {
+                ++free_slot;
+            }
+            table.seeds[bucket_of[i]] = -static_cast<int32_t>(free_slot) - 1;
+            place(free_slot, i);
+        }
+        return table;
+    }
+
+    template <typename T>
+    inline constexpr auto member_name_table_v = make_member_name_table(get_member_names<T>());
+
+    /**
+     * @brief 名字 -> 成员下标
+     * @return 成员下标, 不存在时返回 member_npos
+     */
+    template <typename T>
+    inline constexpr std::size_t member_index_by_name(std::string_view name) noexcept {
+        return member_name_table_v<remove_cvref_t<T>>.find(name);
+    }
+
+    template <class Obj, class Visitor, std::size_t I>
+    inline constexpr void _visit_member_thunk(Obj& obj, Visitor& visitor) {
+        visit_members(obj, [&visitor](auto&... members) { visitor(*get_member_ptr<I>(make_member_ptr_table(&members...))); });
+    }
+
+    /**
+     * @brief 把下标为 index 的成员传给 visitor, 通过编译期生成的跳转表一次间接调用完成
+     *
+     * index 必须小于成员个数
+     */
+    template <class Obj, class Visitor>
+    inline constexpr void visit_member_at(Obj& obj, std::size_t index, Visitor&& visitor) {
+        using Table = std::array<void (*)(Obj&, std::remove_reference_t<Visitor>&), members_count_v<remove_cvref_t<Obj>>>;
+        constexpr Table table = []<std::size_t... Is>(std::index_sequence<Is...>) {
+            return Table{&_visit_member_thunk<Obj, std::remove_reference_t<Visitor>, Is>...};
+        }(std::make_index_sequence<members_count_v<remove_cvref_t<Obj>>>{});
+        table[index](obj, visitor);
+    }
+
+    /**
+     * @brief 把名为 name 的成员传给 visitor
+     * @return 是否存在这个成员
+     */
+    template <class Obj, class Visitor>
+    inline constexpr bool visit_member_by_name(Obj& obj, std::string_view name, Visitor&& visitor) {
+        const std::size_t index = member_index_by_name<Obj>(name);
+        if (index == member_npos) {
+            return false;
+        }
+        visit_member_at(obj, index, visitor);
+        return true;
+    }
+
+    /**
+     * @brief 按名字读写成员时, 是否允许把 From 类型的值赋给 To 类型 (两者都已 decay)
+     *
+     * 默认只允许类型完全相同, 避免 int -> std::string、double -> int 之类的隐式转换悄悄改掉数据;
+     * 确实需要转换时显式特化, 如 template <> inline constexpr bool reflect::member_assignable_v<std::string, const char*> = true;
+     */
+    template <class To, class From>
+    inline constexpr bool member_assignable_v = std::is_same_v<To, From>;
+
+    /**
+     * @brief 按名字给成员赋值
+     * @return 成员存在且 member_assignable_v<成员类型, V> 成立时赋值并返回 true
+     */
+    template <class T, class V>
+    inline constexpr bool set_member_by_name(T& obj, std::string_view name, V&& value) {
+        bool assigned = false;
+        visit_member_by_name(obj, name, [&](auto& member) {
+            using Member = std::decay_t<decltype(member)>;
+            if constexpr (member_assignable_v<Member, std::decay_t<V>> && std::is_assignable_v<decltype(member), V&&>) {
+                member   = std::forward<V>(value);
+                assigned = true;
+            }
+        });
+        return assigned;
+    }
+
+    /**
+     * @brief 按名字读取成员到 out
+     * @return 成员存在且 member_assignable_v<V, 成员类型> 成立时赋值并返回 true
+     */
+    template <class T, class V>
+    inline constexpr bool get_member_by_name(const T& obj, std::string_view name, V& out) {
+        bool assigned = false;
+        visit_member_by_name(obj, name, [&](const auto& member) {
+            using Member = std::decay_t<decltype(member)>;
+            if constexpr (member_assignable_v<std::decay_t<V>, Member> && std::is_assignable_v<V&, decltype(member)>) {
+                out      = member;
+                assigned = true;
+            }
+        });
+        return assigned;
+    }
+
+} // namespace reflect
+
+#endif
@@ -0,0 +1,238 @@
+//! reflect.hpp 大结构体压测: 成员计数、成员名、visit_members 的编译时间与编译内存
+//! 编译期开销用 /usr/bin/time 测量 (看 Elapsed 与 Maximum resident set size), 三种模式对比:
+//!   /usr/bin/time -v g++ -std=c++20 -c reflect_bench.cpp                        完整反射 (计数 + 成员名 + visit_members)
+//!   /usr/bin/time -v g++ -std=c++20 -c reflect_bench.cpp -DREFLECT_BENCH_COUNT  只用倍增 + 二分计数
+//!   /usr/bin/time -v g++ -std=c++20 -c reflect_bench.cpp -DREFLECT_BENCH_LINEAR 只用逐个加参数的线性递归计数
+//! 完整模式链接后运行, 打印各结构体的成员个数、首尾成员名和 visit_members 的结果,
+//! 以及按名字查找 / 赋值时完美哈希与逐个比较名字的线性扫描的耗时
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "reflect.hpp"
+
+using namespace reflect;
+
+// 每组 8 个不同类型的成员, 名字是 前缀 + 0~7
+#define REFLECT_BENCH_FIELDS_8(p) \
+    int                p##0;      \
+    double             p##1;      \
+    std::string        p##2;      \
+    int64_t            p##3;      \
+    char               p##4;      \
+    float              p##5;      \
+    std::array<int, 2> p##6;      \
+    uint16_t           p##7;
+
+struct Wide16 {
+    REFLECT_BENCH_FIELDS_8(a)
+    REFLECT_BENCH_FIELDS_8(b)
+};
+
+struct Wide64 {
+    REFLECT_BENCH_FIELDS_8(a)
+    REFLECT_BENCH_FIELDS_8(b)
+    REFLECT_BENCH_FIELDS_8(c)
+    REFLECT_BENCH_FIELDS_8(d)
+    REFLECT_BENCH_FIELDS_8(e)
+    REFLECT_BENCH_FIELDS_8(f)
+    REFLECT_BENCH_FIELDS_8(g)
+    REFLECT_BENCH_FIELDS_8(h)
+};
+
+struct Wide120 {
+    REFLECT_BENCH_FIELDS_8(a)
+    REFLECT_BENCH_FIELDS_8(b)
+    REFLECT_BENCH_FIELDS_8(c)
+    REFLECT_BENCH_FIELDS_8(d)
+    REFLECT_BENCH_FIELDS_8(e)
+    REFLECT_BENCH_FIELDS_8(f)
+    REFLECT_BENCH_FIELDS_8(g)
+    REFLECT_BENCH_FIELDS_8(h)
+    REFLECT_BENCH_FIELDS_8(i)
+    REFLECT_BENCH_FIELDS_8(j)
+    REFLECT_BENCH_FIELDS_8(k)
+    REFLECT_BENCH_FIELDS_8(l)
+    REFLECT_BENCH_FIELDS_8(m)
+    REFLECT_BENCH_FIELDS_8(n)
+    REFLECT_BENCH_FIELDS_8(o)
+};
+
+struct Wide128 {
+    REFLECT_BENCH_FIELDS_8(a)
+    REFLECT_BENCH_FIELDS_8(b)
+    REFLECT_BENCH_FIELDS_8(c)
+    REFLECT_BENCH_FIELDS_8(d)
+    REFLECT_BENCH_FIELDS_8(e)
+    REFLECT_BENCH_FIELDS_8(f)
+    REFLECT_BENCH_FIELDS_8(g)
+    REFLECT_BENCH_FIELDS_8(h)
+    REFLECT_BENCH_FIELDS_8(i)
+    REFLECT_BENCH_FIELDS_8(j)
+    REFLECT_BENCH_FIELDS_8(k)
+    REFLECT_BENCH_FIELDS_8(l)
+    REFLECT_BENCH_FIELDS_8(m)
+    REFLECT_BENCH_FIELDS_8(n)
+    REFLECT_BENCH_FIELDS_8(o)
+    REFLECT_BENCH_FIELDS_8(p)
+};
+
+#if defined(REFLECT_BENCH_LINEAR)
+
+/**
+ * @brief 旧的计数方式: 每次多加一个 Any 重新实例化, n 个成员需要 n + 1 层递归
+ */
+template <class T, class... Args>
+consteval std::size_t linear_member_count() {
+    if constexpr (requires { T{{Args{}}..., {Any{}}}; } == false) {
+        return sizeof...(Args);
+    } else {
+        return linear_member_count<T, Args..., Any>();
+    }
+}
+
+static_assert(linear_member_count<Wide16>() == 16);
+static_assert(linear_member_count<Wide64>() == 64);
+static_assert(linear_member_count<Wide120>() == 120);
+static_assert(linear_member_count<Wide128>() == 128);
+
+#elif defined(REFLECT_BENCH_COUNT)
+
+static_assert(members_count_v<Wide16> == 16);
+static_assert(members_count_v<Wide64> == 64);
+static_assert(members_count_v<Wide120> == 120);
+static_assert(members_count_v<Wide128> == 128);
+
+#else
+
+template <class T>
+void report(std::string_view type_name) {
+    constexpr auto names = get_member_names<T>();
+    T              obj{};
+    // 给所有 int 成员依次赋值 0, 1, 2..., 再求和, 确认 visit_members 按声明顺序拿到了每个成员
+    int next = 0;
+    visit_members(obj, [&](auto&... members) {
+        ([&](auto& m) {
+            if constexpr (std::is_same_v<remove_cvref_t<decltype(m)>, int>) {
+                m = next++;
+            }
+        }(members), ...);
+    });
+    long sum = visit_members(std::as_const(obj), [](const auto&... members) {
+        long s = 0;
+        ([&](const auto& m) {
+            if constexpr (std::is_same_v<remove_cvref_t<decltype(m)>, int>) {
+                s += m;
+            }
+        }(members), ...);
+        return s;
+    });
+    std::cout << type_name << ": " << names.size() << " members, first " << names.front() << ", last " << names.back()
+              << ", int members sum " << sum << '\n';
+}
+
+//! 线性扫描: 逐个比较 get_member_names 的结果
+template <class T>
+std::size_t linear_index_by_name(std::string_view name) {
+    constexpr auto names = get_member_names<T>();
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == name) {
+            return i;
+        }
+    }
+    return member_npos;
+}
+
+//! 线性扫描: 在 visit_members 里逐个比较名字, 命中后停止扫描, 类型相同时赋值
+template <class T, class V>
+bool linear_set_by_name(T& obj, std::string_view name, const V& value) {
+    constexpr auto names    = get_member_names<T>();
+    bool           assigned = false;
+    visit_members(obj, [&](auto&... members) {
+        std::size_t i = 0;
+        static_cast<void>(((names[i++] == name && ([&](auto& member) {
+                                 if constexpr (member_assignable_v<std::decay_t<decltype(member)>, V>) {
+                                     member   = value;
+                                     assigned = true;
+                                 }
+                             }(members),
+                             true)) ||
+                           ...));
+    });
+    return assigned;
+}
+
+template <class F>
+double ns_per_op(std::size_t ops, F&& f) {
+    const auto begin = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(ops);
+}
+
+/**
+ * @brief 对 T 的全部成员名 (运行期字符串, 打乱顺序) 反复按名字查找和赋值
+ */
+template <class T>
+void bench_lookup(std::string_view type_name) {
+    constexpr auto           names = get_member_names<T>();
+    std::vector<std::string> keys;
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        keys.emplace_back(names[(i * 7 + 3) % names.size()]);
+    }
+    const std::size_t rounds = 2000000 / keys.size();
+    const std::size_t ops    = rounds * keys.size();
+    T                 obj{};
+    std::size_t       sink = 0;
+
+    const double hash_find = ns_per_op(ops, [&] {
+        for (std::size_t r = 0; r < rounds; ++r) {
+            for (const auto& key : keys) {
+                sink += member_index_by_name<T>(key);
+            }
+        }
+    });
+    const double linear_find = ns_per_op(ops, [&] {
+        for (std::size_t r = 0; r < rounds; ++r) {
+            for (const auto& key : keys) {
+                sink += linear_index_by_name<T>(key);
+            }
+        }
+    });
+    const double hash_set = ns_per_op(ops, [&] {
+        for (std::size_t r = 0; r < rounds; ++r) {
+            for (const auto& key : keys) {
+                sink += set_member_by_name(obj, key, static_cast<int>(r));
+            }
+        }
+    });
+    const double linear_set = ns_per_op(ops, [&] {
+        for (std::size_t r = 0; r < rounds; ++r) {
+            for (const auto& key : keys) {
+                sink += linear_set_by_name(obj, key, static_cast<int>(r));
+            }
+        }
+    });
+    std::cout << type_name << ": find hash " << hash_find << " ns, linear " << linear_find << " ns; set hash " << hash_set
+              << " ns, linear " << linear_set << " ns (sink " << sink % 10 << ")\n";
+}
+
+int main() {
+    static_assert(members_count_v<Wide128> == reflect_max_members);
+    report<Wide16>("Wide16");
+    report<Wide64>("Wide64");
+    report<Wide120>("Wide120");
+    report<Wide128>("Wide128");
+
+    bench_lookup<Wide16>("Wide16");
+    bench_lookup<Wide64>("Wide64");
+    bench_lookup<Wide128>("Wide128");
+    return 0;
+}
+
+#endif
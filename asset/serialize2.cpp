@@ -1,10 +1,45 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bit>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cerrno>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "reflect.hpp"
 void endian() {
     union U {
         short v;
@@ -32,67 +67,2203 @@ T byteswap(T value) {
     return value;
 }
 
+/**
+ * @brief 与 sizeof(T) 同宽的无符号整数, 用于把 double 等类型交给 std::byteswap
+ */
+template <size_t N>
+struct uint_of_size;
+template <>
+struct uint_of_size<2> {
+    using type = uint16_t;
+};
+template <>
+struct uint_of_size<4> {
+    using type = uint32_t;
+};
+template <>
+struct uint_of_size<8> {
+    using type = uint64_t;
+};
+
 template <typename T>
     requires(sizeof(T) > 1 && is_system_little_endian)
 T byteswap(T value) {
-    return brute_byteswap(value);
+    if constexpr (std::is_integral_v<T>) {
+        return std::byteswap(value); // 编译为一条 bswap / movbe
+    } else if constexpr (requires { typename uint_of_size<sizeof(T)>::type; } && std::is_trivially_copyable_v<T>) {
+        using U = typename uint_of_size<sizeof(T)>::type;
+        return std::bit_cast<T>(std::byteswap(std::bit_cast<U>(value)));
+    } else {
+        return brute_byteswap(value);
+    }
 }
 
-struct Person {
-    int    a;
-    double b;
-    char   c;
+/*
+批量端序转换: 对连续的 2/4/8 字节元素数组, 用 pshufb/vpshufb 一次反转 16/32 字节,
+尾部用 std::byteswap; 大端机器上不需要转换, 整个函数在编译期变成 memcpy 或空操作
+*/
+namespace detail {
+    template <size_t N>
+    void byteswap_copy(const std::byte* src, std::byte* dst, size_t count) noexcept {
+        size_t i = 0;
+#if defined(__SSSE3__) || defined(__AVX2__)
+        // 每个 16 字节 lane 内把每个元素的字节倒序
+        static constexpr auto mask_bytes = [] {
+            std::array<uint8_t, 16> m{};
+            for (size_t b = 0; b < 16; b++) {
+                m[b] = static_cast<uint8_t>(b / N * N + (N - 1 - b % N));
+            }
+            return m;
+        }();
+        const __m128i mask128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask_bytes.data()));
+#if defined(__AVX2__)
+        const __m256i mask256 = _mm256_broadcastsi128_si256(mask128);
+        for (; (i + 32 / N) <= count; i += 32 / N) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * N));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * N), _mm256_shuffle_epi8(v, mask256));
+        }
+#endif
+        for (; (i + 16 / N) <= count; i += 16 / N) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * N));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * N), _mm_shuffle_epi8(v, mask128));
+        }
+#endif
+        for (; i < count; i++) {
+            if constexpr (N == 16) {
+                // long double 没有同宽的标准整数类型, 逐字节反转
+                std::array<std::byte, N> v;
+                memcpy(v.data(), src + i * N, N);
+                std::ranges::reverse(v);
+                memcpy(dst + i * N, v.data(), N);
+            } else {
+                using U = typename uint_of_size<N>::type;
+                U v;
+                memcpy(&v, src + i * N, N);
+                v = std::byteswap(v);
+                memcpy(dst + i * N, &v, N);
+            }
+        }
+    }
+} // namespace detail
+
+template <typename T>
+concept bulk_swappable = std::is_trivially_copyable_v<T> && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8 || sizeof(T) == 16);
+
+/**
+ * @brief 原地批量转换端序
+ */
+template <bulk_swappable T>
+void byteswap_span(std::span<T> data) noexcept {
+    if constexpr (sizeof(T) > 1 && is_system_little_endian) {
+        auto* p = reinterpret_cast<std::byte*>(data.data());
+        detail::byteswap_copy<sizeof(T)>(p, p, data.size());
+    }
+}
+/**
+ * @brief 拷贝的同时转换端序, dst 与 src 可以是未对齐的字节缓冲区, 但不能部分重叠
+ */
+template <bulk_swappable T>
+void byteswap_span(std::span<const T> src, std::byte* dst) noexcept {
+    if constexpr (sizeof(T) > 1 && is_system_little_endian) {
+        detail::byteswap_copy<sizeof(T)>(reinterpret_cast<const std::byte*>(src.data()), dst, src.size());
+    } else {
+        memcpy(dst, src.data(), src.size_bytes());
+    }
+}
+template <bulk_swappable T>
+void byteswap_span(const std::byte* src, std::span<T> dst) noexcept {
+    if constexpr (sizeof(T) > 1 && is_system_little_endian) {
+        detail::byteswap_copy<sizeof(T)>(src, reinterpret_cast<std::byte*>(dst.data()), dst.size());
+    } else {
+        memcpy(dst.data(), src, dst.size_bytes());
+    }
+}
+template <bulk_swappable T>
+void byteswap_span(std::span<const T> src, std::span<T> dst) noexcept {
+    byteswap_span(src, reinterpret_cast<std::byte*>(dst.data()));
+}
+
+/*
+输出目标(sink): 序列化函数不自己分配内存, 而是向 sink 申请空间:
+  std::byte* reserve(n)  返回至少 n 字节的可写空间
+  void       commit(n)   确认刚才 reserve 的空间里写入了 n 字节
+已有内容之外的空间在 clear() 后会被复用, 稳定状态下不再分配内存
+*/
+template <typename S>
+concept byte_sink = requires(S& s, size_t n) {
+    { s.reserve(n) } -> std::same_as<std::byte*>;
+    s.commit(n);
+};
+
+/**
+ * @brief 追加到调用方的 std::vector, 兼容原来返回 vector 的接口
+ */
+class vector_sink {
+public:
+    explicit vector_sink(std::vector<std::byte>& v) noexcept : v_(v) {}
+    std::byte* reserve(size_t n) {
+        pos_ = v_.size();
+        v_.resize(pos_ + n);
+        return v_.data() + pos_;
+    }
+    void commit(size_t n) { v_.resize(pos_ + n); }
+
+private:
+    std::vector<std::byte>& v_;
+    size_t                  pos_ = 0;
+};
+
+/**
+ * @brief 可复用的增长缓冲区, 容量按 2 倍增长且 clear() 不释放, 也不像 vector::resize 那样清零
+ */
+class arena_sink {
+public:
+    explicit arena_sink(size_t capacity = 4096) : buf_(new std::byte[capacity]), cap_(capacity) {}
+
+    std::byte* reserve(size_t n) {
+        if (size_ + n > cap_) {
+            grow(size_ + n);
+        }
+        return buf_.get() + size_;
+    }
+    void commit(size_t n) noexcept { size_ += n; }
+    void clear() noexcept { size_ = 0; }
+
+    std::span<const std::byte> bytes() const noexcept { return {buf_.get(), size_}; }
+    std::byte*                 data() noexcept { return buf_.get(); }
+    size_t                     capacity() const noexcept { return cap_; }
+
+private:
+    void grow(size_t need) {
+        // 初始容量可以是 0, 不能只靠翻倍
+        const size_t cap = std::max<size_t>(cap_ * 2, need);
+        std::unique_ptr<std::byte[]> buf(new std::byte[cap]);
+        memcpy(buf.get(), buf_.get(), size_);
+        buf_ = std::move(buf);
+        cap_ = cap;
+    }
+
+    std::unique_ptr<std::byte[]> buf_;
+    size_t                       cap_;
+    size_t                       size_ = 0;
+};
+
+/**
+ * @brief 写入调用方提供的定长缓冲区, 空间不足时抛出 std::length_error
+ */
+class fixed_sink {
+public:
+    explicit fixed_sink(std::span<std::byte> buf) noexcept : buf_(buf) {}
+
+    std::byte* reserve(size_t n) {
+        if (n > buf_.size() - size_) {
+            throw std::length_error("fixed_sink: buffer is full");
+        }
+        return buf_.data() + size_;
+    }
+    void commit(size_t n) noexcept { size_ += n; }
+    void clear() noexcept { size_ = 0; }
+
+    std::span<const std::byte> bytes() const noexcept { return buf_.first(size_); }
+
+private:
+    std::span<std::byte> buf_;
+    size_t               size_ = 0;
+};
+
+/**
+ * @brief scatter/gather 输出: 编码出的字节放在固定大小的块里(地址稳定, clear() 后复用),
+ * 大块的外部数据可以用 append_ref 直接引用而不拷贝, 最后把 iovec 列表交给 writev
+ */
+class iovec_sink {
+public:
+    static constexpr size_t block_size = 64 << 10;
+
+    std::byte* reserve(size_t n) {
+        if (blocks_.empty() || used_ + n > block_len(cur_)) {
+            next_block(n);
+        }
+        return blocks_[cur_].data.get() + used_;
+    }
+    void commit(size_t n) {
+        std::byte* p = blocks_[cur_].data.get() + used_;
+        // 和上一个 iovec 首尾相接时直接合并
+        if (!iov_.empty() && static_cast<std::byte*>(iov_.back().iov_base) + iov_.back().iov_len == p) {
+            iov_.back().iov_len += n;
+        } else {
+            iov_.push_back({p, n});
+        }
+        used_ += n;
+    }
+    /**
+     * @brief 引用外部数据, 在 writev 完成前 data 必须保持有效
+     */
+    void append_ref(const void* data, size_t n) {
+        iov_.push_back({const_cast<void*>(data), n});
+    }
+    void clear() noexcept {
+        iov_.clear();
+        cur_  = 0;
+        used_ = 0;
+    }
+
+    std::span<const iovec> iovecs() const noexcept { return iov_; }
+    size_t                 size() const noexcept {
+        size_t n = 0;
+        for (const auto& v : iov_) {
+            n += v.iov_len;
+        }
+        return n;
+    }
+    /**
+     * @brief 全部写入 fd, 处理部分写入和 IOV_MAX 限制
+     *
+     * 通常直接对 iov_ 调用 writev, 不拷贝; 只有某一项只写了一部分时, 才把剩余的 iovec
+     * 拷到复用的 pending_ 里调整, iov_ 本身保持不变
+     *
+     * @return 成功返回 true, 失败时 errno 有效
+     */
+    bool write_to(int fd) const {
+        const iovec* iov        = iov_.data();
+        size_t       count      = iov_.size();
+        bool         in_pending = false;
+        while (count > 0) {
+            const ssize_t n = ::writev(fd, iov, static_cast<int>(std::min<size_t>(count, IOV_MAX)));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            size_t left = static_cast<size_t>(n);
+            while (count > 0 && left >= iov->iov_len) {
+                left -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (left > 0) {
+                if (!in_pending) {
+                    pending_.assign(iov, iov + count);
+                    iov        = pending_.data();
+                    in_pending = true;
+                }
+                iovec& head   = pending_[static_cast<size_t>(iov - pending_.data())];
+                head.iov_base = static_cast<std::byte*>(head.iov_base) + left;
+                head.iov_len -= left;
+            }
+        }
+        return true;
+    }
+
+private:
+    struct block {
+        std::unique_ptr<std::byte[]> data;
+        size_t                       len;
+    };
+    size_t block_len(size_t i) const noexcept { return blocks_[i].len; }
+    void   next_block(size_t n) {
+        if (!blocks_.empty()) {
+            cur_++;
+        }
+        // 复用 clear() 之前分配的块
+        while (cur_ < blocks_.size() && block_len(cur_) < n) {
+            cur_++;
+        }
+        if (cur_ >= blocks_.size()) {
+            const size_t len = std::max(n, block_size);
+            blocks_.push_back({std::unique_ptr<std::byte[]>(new std::byte[len]), len});
+            cur_ = blocks_.size() - 1;
+        }
+        used_ = 0;
+    }
+
+    std::vector<block>         blocks_;
+    std::vector<iovec>         iov_;
+    mutable std::vector<iovec> pending_; // write_to 遇到部分写入时的剩余项, 复用容量
+    size_t                     cur_  = 0;
+    size_t                     used_ = 0;
 };
 
+/*
+基于反射的通用序列化: 线上格式就是结构体本身的内存布局(含对齐), 每个标量按大端序存放, 填充字节清零
+字段偏移、需要转换端序的位置、填充位置都在编译期算好, 运行时是一次整体 memcpy
+再加上若干次(相邻同宽字段合并后的)批量 byteswap
+
+输入不可信, 解码不能产生非法的对象表示:
+  - bool 按字节读取, 非 0 即 true
+  - 枚举只支持固定底层类型的 (enum class 或 enum E : int), 这样底层类型的任何值都是合法的枚举值,
+    不在枚举项里的值原样保留, 由使用者检查
+  - long double 按 16 字节整体反转; x87 的 80 位格式后 6 字节是填充, 编码时清零
+*/
+template <typename T>
+concept fixed_enum = std::is_enum_v<T> && requires { T{std::underlying_type_t<T>{}}; };
+
+template <typename T>
+concept wire_scalar = std::is_arithmetic_v<T> || fixed_enum<T> || std::is_same_v<T, std::byte>;
+
+//! long double 中真正存放数值的字节数, x87 扩展精度是 10 字节
+template <typename T>
+constexpr size_t value_bytes_v = std::is_same_v<T, long double> && std::numeric_limits<long double>::digits == 64 ? 10 : sizeof(T);
+
+template <typename T>
+struct is_std_array : std::false_type {};
+template <typename E, size_t N>
+struct is_std_array<std::array<E, N>> : std::true_type {};
+
+// 只用于 decltype, 收集结构体成员类型
+struct member_types_visitor {
+    template <typename... Ms>
+    constexpr auto operator()(Ms&...) const {
+        return std::type_identity<std::tuple<std::remove_cvref_t<Ms>...>>{};
+    }
+};
+template <typename T>
+using member_types_t = typename decltype(reflect::visit_members(std::declval<T&>(), member_types_visitor{}))::type;
+
+template <typename T>
+constexpr bool is_fixed_wire_v = [] {
+    if constexpr (wire_scalar<T>) {
+        return true;
+    } else if constexpr (is_std_array<T>::value) {
+        return is_fixed_wire_v<typename T::value_type>;
+    } else if constexpr (std::is_aggregate_v<T> && std::is_trivially_copyable_v<T>) {
+        return []<typename... Ms>(std::type_identity<std::tuple<Ms...>>) {
+            return (is_fixed_wire_v<Ms> && ...);
+        }(std::type_identity<member_types_t<T>>{});
+    } else {
+        return false;
+    }
+}();
+
+//! 一段连续的字节区间; 对于端序转换, 表示从 offset 开始 count 个 size 字节的元素
+struct wire_range {
+    size_t offset;
+    size_t size;
+    size_t count;
+};
+
+namespace detail {
+    constexpr size_t align_up(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+    /**
+     * @brief 按成员声明顺序和对齐规则计算每个标量的位置, 结果写入 swaps(需要转换端序的)、data(所有有效字节)
+     * 和 bools(解码后需要规范化为 0/1 的字节)
+     * @return T 的大小, 用于和 sizeof(T) 核对布局
+     */
+    template <typename T>
+    constexpr size_t collect_layout(std::vector<wire_range>& swaps, std::vector<wire_range>& data, std::vector<wire_range>& bools,
+                                    size_t base) {
+        if constexpr (wire_scalar<T>) {
+            if (sizeof(T) > 1) {
+                swaps.push_back({base, sizeof(T), 1});
+            }
+            if (std::is_same_v<T, bool>) {
+                bools.push_back({base, 1, 1});
+            }
+            data.push_back({base, value_bytes_v<T>, 1});
+        } else if constexpr (is_std_array<T>::value) {
+            using E = typename T::value_type;
+            if constexpr (wire_scalar<E> && value_bytes_v<E> == sizeof(E)) {
+                if (sizeof(E) > 1) {
+                    swaps.push_back({base, sizeof(E), std::tuple_size_v<T>});
+                }
+                if (std::is_same_v<E, bool>) {
+                    bools.push_back({base, 1, std::tuple_size_v<T>});
+                }
+                data.push_back({base, sizeof(E) * std::tuple_size_v<T>, 1});
+            } else {
+                for (size_t i = 0; i < std::tuple_size_v<T>; i++) {
+                    collect_layout<E>(swaps, data, bools, base + i * sizeof(E));
+                }
+            }
+        } else {
+            size_t off = 0;
+            [&]<typename... Ms>(std::type_identity<std::tuple<Ms...>>) {
+                ((off = align_up(off, alignof(Ms)), collect_layout<Ms>(swaps, data, bools, base + off), off += sizeof(Ms)), ...);
+            }(std::type_identity<member_types_t<T>>{});
+            return align_up(off, alignof(T));
+        }
+        return sizeof(T);
+    }
+
+    // 合并首尾相接的区间; 端序转换只合并元素宽度相同的
+    constexpr std::vector<wire_range> merge_ranges(const std::vector<wire_range>& in, bool same_size) {
+        std::vector<wire_range> out;
+        for (const auto& r : in) {
+            if (!out.empty()) {
+                auto& last = out.back();
+                if (same_size && last.size == r.size && last.offset + last.size * last.count == r.offset) {
+                    last.count += r.count;
+                    continue;
+                }
+                if (!same_size && last.offset + last.size == r.offset) {
+                    last.size += r.size;
+                    continue;
+                }
+            }
+            out.push_back(r);
+        }
+        return out;
+    }
+    template <typename T>
+    constexpr std::vector<wire_range> swap_ranges() {
+        std::vector<wire_range> swaps, data, bools;
+        collect_layout<T>(swaps, data, bools, 0);
+        return merge_ranges(swaps, true);
+    }
+    template <typename T>
+    constexpr std::vector<wire_range> bool_ranges() {
+        std::vector<wire_range> swaps, data, bools;
+        collect_layout<T>(swaps, data, bools, 0);
+        return merge_ranges(bools, true);
+    }
+    // 填充字节 = 数据区间的补集
+    template <typename T>
+    constexpr std::vector<wire_range> padding_ranges() {
+        std::vector<wire_range> swaps, data, bools, pad;
+        collect_layout<T>(swaps, data, bools, 0);
+        size_t pos = 0;
+        for (const auto& r : merge_ranges(data, false)) {
+            if (r.offset > pos) {
+                pad.push_back({pos, r.offset - pos, 1});
+            }
+            pos = r.offset + r.size;
+        }
+        if (pos < sizeof(T)) {
+            pad.push_back({pos, sizeof(T) - pos, 1});
+        }
+        return pad;
+    }
+    template <typename T>
+    constexpr size_t layout_size() {
+        std::vector<wire_range> swaps, data, bools;
+        return collect_layout<T>(swaps, data, bools, 0);
+    }
+
+    // constexpr std::vector 不能直接留到运行期, 先求出长度再拷贝到 std::array
+    template <auto F>
+    constexpr auto to_array() {
+        constexpr size_t N = F().size();
+        std::array<wire_range, N> arr{};
+        const auto                v = F();
+        std::copy(v.begin(), v.end(), arr.begin());
+        return arr;
+    }
+} // namespace detail
+
+template <typename T>
+constexpr auto swap_plan_v = detail::to_array<detail::swap_ranges<T>>();
+template <typename T>
+constexpr auto padding_plan_v = detail::to_array<detail::padding_ranges<T>>();
+template <typename T>
+constexpr auto bool_plan_v = detail::to_array<detail::bool_ranges<T>>();
+
+/**
+ * @brief 对 p 指向的 T 的线上表示(或对象本身)按编译期计划转换端序
+ */
+template <typename T>
+void swap_fields(std::byte* p) noexcept {
+    if constexpr (is_system_little_endian) {
+        constexpr auto& plan = swap_plan_v<T>;
+        [p]<size_t... I>(std::index_sequence<I...>) {
+            (detail::byteswap_copy<plan[I].size>(p + plan[I].offset, p + plan[I].offset, plan[I].count), ...);
+        }(std::make_index_sequence<plan.size()>{});
+    }
+}
+
+/**
+ * @brief 把 obj 写到 out 开始的 sizeof(T) 个字节
+ */
+template <typename T>
+    requires is_fixed_wire_v<T>
+void encode_fixed(const T& obj, std::byte* out) noexcept {
+    static_assert(detail::layout_size<T>() == sizeof(T), "unexpected struct layout");
+    memcpy(out, &obj, sizeof(T));
+    // 先按本机布局清零填充 (包括 long double 的填充字节), 再转换端序
+    for (const auto& pad : padding_plan_v<T>) {
+        memset(out + pad.offset, 0, pad.size);
+    }
+    swap_fields<T>(out);
+}
+/**
+ * @brief 从 in 开始的 sizeof(T) 个字节读出 T, in 不需要对齐
+ */
+template <typename T>
+    requires is_fixed_wire_v<T>
+void decode_fixed(const std::byte* in, T& obj) noexcept {
+    auto* p = reinterpret_cast<std::byte*>(&obj);
+    memcpy(p, in, sizeof(T));
+    swap_fields<T>(p);
+    // bool 只有 0/1 两种合法表示, 在按 bool 读取之前先规范化
+    for (const auto& r : bool_plan_v<T>) {
+        for (size_t i = 0; i < r.count; i++) {
+            p[r.offset + i] = static_cast<std::byte>(p[r.offset + i] != std::byte{0});
+        }
+    }
+}
+
+/**
+ * @brief 把 obj 追加到 sink
+ */
+template <typename T, byte_sink S>
+    requires is_fixed_wire_v<T>
+void serialize_to(S& sink, const T& obj) {
+    encode_fixed(obj, sink.reserve(sizeof(T)));
+    sink.commit(sizeof(T));
+}
+
+template <typename T>
+    requires is_fixed_wire_v<T>
+std::vector<std::byte> serialize(const T& obj) {
+    std::vector<std::byte> res(sizeof(T));
+    encode_fixed(obj, res.data());
+    return res;
+}
+
+template <typename T>
+    requires is_fixed_wire_v<T>
+T deserialize(std::span<const std::byte> seq) {
+    if (seq.size() < sizeof(T)) {
+        throw std::out_of_range("deserialize: buffer is smaller than the type");
+    }
+    T obj;
+    decode_fixed(seq.data(), obj);
+    return obj;
+}
+
+/*
+零拷贝只读视图: 只保存指向缓冲区的指针, 构造时检查一次长度,
+之后访问某个字段时才按编译期偏移 memcpy + byteswap 解码, 与记录大小无关
+*/
+template <typename T>
+constexpr auto member_offsets_v = [] {
+    std::array<size_t, reflect::members_count_v<T>> off{};
+    size_t                                 pos = 0, i = 0;
+    [&]<typename... Ms>(std::type_identity<std::tuple<Ms...>>) {
+        ((pos = detail::align_up(pos, alignof(Ms)), off[i++] = pos, pos += sizeof(Ms)), ...);
+    }(std::type_identity<member_types_t<T>>{});
+    return off;
+}();
+
+template <typename T>
+    requires is_fixed_wire_v<T>
+class serialized_view;
+template <typename E, size_t N>
+class serialized_array_view;
+
+namespace detail {
+    //! 已经检查过边界的指针, 只在视图内部传递
+    struct unchecked_ptr {
+        const std::byte* p;
+    };
+    template <typename T>
+    auto view_at(const std::byte* p) noexcept {
+        if constexpr (std::is_same_v<T, bool>) {
+            return *p != std::byte{0};
+        } else if constexpr (wire_scalar<T>) {
+            T v;
+            memcpy(&v, p, sizeof(T)); // 未对齐也安全
+            return byteswap(v);
+        } else if constexpr (is_std_array<T>::value) {
+            return serialized_array_view<typename T::value_type, std::tuple_size_v<T>>{unchecked_ptr{p}};
+        } else {
+            return serialized_view<T>{unchecked_ptr{p}};
+        }
+    }
+} // namespace detail
+
 template <typename T>
-std::byte* find_next_align(const std::byte* ptr) {
-    auto u_ptr = reinterpret_cast<uint64_t>(ptr);
-    u_ptr      = (u_ptr + ((1 << sizeof(T)) - 1)) & (~((1 << sizeof(T)) - 1));
-    return reinterpret_cast<std::byte*>(u_ptr);
+    requires is_fixed_wire_v<T>
+class serialized_view {
+public:
+    /**
+     * @brief 检查 buf 至少包含一个 T, 否则抛出 std::out_of_range
+     */
+    explicit serialized_view(std::span<const std::byte> buf) : data_(buf.data()) {
+        if (buf.size() < sizeof(T)) {
+            throw std::out_of_range("serialized_view: buffer is smaller than the type");
+        }
+    }
+    explicit serialized_view(detail::unchecked_ptr ptr) noexcept : data_(ptr.p) {}
+
+    /**
+     * @brief 第 I 个成员: 标量直接解码返回, 结构体和 std::array 返回子视图
+     */
+    template <size_t I>
+    auto get() const noexcept {
+        using M = std::tuple_element_t<I, member_types_t<T>>;
+        return detail::view_at<M>(data_ + member_offsets_v<T>[I]);
+    }
+    /**
+     * @brief 解码整个对象
+     */
+    T load() const noexcept {
+        T obj;
+        decode_fixed(data_, obj);
+        return obj;
+    }
+    const std::byte* data() const noexcept { return data_; }
+
+private:
+    const std::byte* data_;
+};
+
+template <typename E, size_t N>
+class serialized_array_view {
+public:
+    explicit serialized_array_view(detail::unchecked_ptr ptr) noexcept : data_(ptr.p) {}
+
+    static constexpr size_t size() noexcept { return N; }
+    //! i 不做检查, 与 std::array::operator[] 一致
+    auto operator[](size_t i) const noexcept { return detail::view_at<E>(data_ + i * sizeof(E)); }
+    auto at(size_t i) const {
+        if (i >= N) {
+            throw std::out_of_range("serialized_array_view::at");
+        }
+        return (*this)[i];
+    }
+
+private:
+    const std::byte* data_;
+};
+
+/*
+整数压缩: zigzag + varint(LEB128, 每字节低 7 位存数据, 最高位表示后面还有字节)
+以及 Stream VByte: 每 4 个 uint32 共用 1 个控制字节(每个数 2 bit 记录 1~4 字节长度),
+数据字节与控制字节分开存放, 解码时用控制字节查表得到 pshufb 的 shuffle mask, 一次解出 4 个数
+*/
+template <std::signed_integral T>
+constexpr std::make_unsigned_t<T> zigzag_encode(T n) noexcept {
+    using U = std::make_unsigned_t<T>;
+    return (static_cast<U>(n) << 1) ^ static_cast<U>(n >> (sizeof(T) * 8 - 1));
+}
+template <std::unsigned_integral U>
+constexpr std::make_signed_t<U> zigzag_decode(U n) noexcept {
+    return static_cast<std::make_signed_t<U>>((n >> 1) ^ (~(n & 1) + 1));
 }
-std::vector<std::byte> serialize(const Person& p) {
-    std::vector<std::byte> res(sizeof(p));
-    auto                   ptr = res.data();
-    auto [a, b, c]             = p;
-    a                          = byteswap(a);
-    b                          = byteswap(b);
-    c                          = byteswap(c);
 
-    memcpy(ptr, &a, sizeof(a));
+template <std::unsigned_integral U>
+constexpr size_t max_varint_size = (sizeof(U) * 8 + 6) / 7;
 
-    ptr += sizeof(a);
-    ptr = find_next_align<decltype(b)>(ptr);
-    memcpy(ptr, &b, sizeof(b));
+/**
+ * @brief 写入一个 varint, out 至少要有 max_varint_size<U> 字节
+ * @return 写入的字节数
+ */
+template <std::unsigned_integral U>
+size_t varint_encode(U v, std::byte* out) noexcept {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = static_cast<std::byte>(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = static_cast<std::byte>(v);
+    return n;
+}
+/**
+ * @brief 读取一个 varint, 只接受 varint_encode 产生的最短编码
+ * @return 下一个未读字节, 数据截断、超出 U 的宽度或不是最短编码时返回 nullptr
+ */
+template <std::unsigned_integral U>
+const std::byte* varint_decode(const std::byte* in, const std::byte* end, U& v) noexcept {
+    // 快速路径: 大部分数据只有 1 个字节
+    if (in < end && static_cast<uint8_t>(*in) < 0x80) {
+        v = static_cast<U>(*in);
+        return in + 1;
+    }
+    constexpr size_t bits   = sizeof(U) * 8;
+    U                result = 0;
+    for (size_t shift = 0; shift < bits && in < end; shift += 7) {
+        const auto b = static_cast<uint8_t>(*in++);
+        // 最后一个字节只剩 bits - shift 位有效, 多出来的位说明值超出了 U
+        if (bits - shift < 7 && (b & 0x7F) >> (bits - shift) != 0) {
+            return nullptr;
+        }
+        result |= static_cast<U>(b & 0x7F) << shift;
+        if (b < 0x80) {
+            // 结尾多出的 0 字节 (如 0x80 0x00) 是冗余编码, 每个值只有一种合法编码
+            if (b == 0) {
+                return nullptr;
+            }
+            v = result;
+            return in;
+        }
+    }
+    return nullptr;
+}
 
-    ptr += sizeof(b);
-    ptr = find_next_align<decltype(c)>(ptr);
-    memcpy(ptr, &c, sizeof(c));
+/**
+ * @brief 把整数数组编码为连续的 varint, 追加到 out; 有符号数先做 zigzag
+ */
+template <std::integral T, byte_sink S>
+void encode_varints(std::span<const T> in, S& out) {
+    using U              = std::make_unsigned_t<T>;
+    std::byte* const beg = out.reserve(in.size() * max_varint_size<U>);
+    std::byte*       p   = beg;
+    for (const T v : in) {
+        if constexpr (std::is_signed_v<T>) {
+            p += varint_encode(zigzag_encode(v), p);
+        } else {
+            p += varint_encode(v, p);
+        }
+    }
+    out.commit(p - beg);
+}
+template <std::integral T>
+void encode_varints(std::span<const T> in, std::vector<std::byte>& out) {
+    vector_sink sink{out};
+    encode_varints(in, sink);
+}
+/**
+ * @brief 解码 out.size() 个 varint
+ * @return 消耗的字节数, 数据不完整时返回 0
+ */
+template <std::integral T>
+size_t decode_varints(std::span<const std::byte> in, std::span<T> out) noexcept {
+    using U               = std::make_unsigned_t<T>;
+    const std::byte* p    = in.data();
+    const std::byte* end  = in.data() + in.size();
+    for (auto& v : out) {
+        U u;
+        if ((p = varint_decode(p, end, u)) == nullptr) {
+            return 0;
+        }
+        if constexpr (std::is_signed_v<T>) {
+            v = zigzag_decode(u);
+        } else {
+            v = u;
+        }
+    }
+    return p - in.data();
+}
+
+namespace detail {
+    constexpr uint8_t svb_length(uint32_t v) { return v < (1u << 8) ? 1 : v < (1u << 16) ? 2 : v < (1u << 24) ? 3 : 4; }
+    // 控制字节 -> 4 个数的数据总长度
+    constexpr auto svb_length_table = [] {
+        std::array<uint8_t, 256> t{};
+        for (size_t c = 0; c < 256; c++) {
+            t[c] = static_cast<uint8_t>((c & 3) + (c >> 2 & 3) + (c >> 4 & 3) + (c >> 6 & 3) + 4);
+        }
+        return t;
+    }();
+    // 控制字节 -> pshufb mask, 0xFF 的位置置零
+    constexpr auto svb_shuffle_table = [] {
+        std::array<std::array<uint8_t, 16>, 256> t{};
+        for (size_t c = 0; c < 256; c++) {
+            uint8_t src = 0;
+            for (size_t j = 0; j < 4; j++) {
+                const size_t len = (c >> (2 * j) & 3) + 1;
+                for (size_t b = 0; b < 4; b++) {
+                    t[c][j * 4 + b] = b < len ? src++ : 0xFF;
+                }
+            }
+        }
+        return t;
+    }();
+
+    inline const std::byte* svb_decode_scalar(uint8_t control, const std::byte* data, uint32_t* out, size_t n) {
+        for (size_t j = 0; j < n; j++) {
+            const size_t len = (control >> (2 * j) & 3) + 1;
+            uint32_t     v   = 0;
+            for (size_t b = 0; b < len; b++) {
+                v |= static_cast<uint32_t>(data[b]) << (8 * b);
+            }
+            out[j] = v;
+            data += len;
+        }
+        return data;
+    }
+} // namespace detail
+
+/**
+ * @brief Stream VByte 编码后的最大长度
+ */
+constexpr size_t streamvbyte_max_size(size_t count) { return (count + 3) / 4 + count * 4; }
 
+namespace detail {
+    template <typename T, byte_sink S, typename F>
+    void streamvbyte_encode(std::span<const T> in, S& out, F to_u32) {
+        const size_t     ctrl_size = (in.size() + 3) / 4;
+        std::byte* const ctrl      = out.reserve(streamvbyte_max_size(in.size()));
+        std::byte*       data      = ctrl + ctrl_size;
+        memset(ctrl, 0, ctrl_size);
+        for (size_t i = 0; i < in.size(); i++) {
+            const uint32_t v   = to_u32(in[i]);
+            const uint8_t  len = svb_length(v);
+            ctrl[i / 4] |= static_cast<std::byte>((len - 1) << (2 * (i % 4)));
+            for (uint8_t b = 0; b < len; b++) {
+                *data++ = static_cast<std::byte>(v >> (8 * b));
+            }
+        }
+        out.commit(data - ctrl);
+    }
+} // namespace detail
+
+/**
+ * @brief Stream VByte 编码, 追加到 out: [控制字节 (count+3)/4 个][数据字节, 小端序]
+ * 元素个数不写入输出, 由调用方记录; 有符号数先做 zigzag
+ */
+template <byte_sink S>
+void streamvbyte_encode(std::span<const uint32_t> in, S& out) {
+    detail::streamvbyte_encode(in, out, [](uint32_t v) { return v; });
+}
+template <byte_sink S>
+void streamvbyte_encode(std::span<const int32_t> in, S& out) {
+    detail::streamvbyte_encode(in, out, [](int32_t v) { return zigzag_encode(v); });
+}
+inline void streamvbyte_encode(std::span<const uint32_t> in, std::vector<std::byte>& out) {
+    vector_sink sink{out};
+    streamvbyte_encode(in, sink);
+}
+inline void streamvbyte_encode(std::span<const int32_t> in, std::vector<std::byte>& out) {
+    vector_sink sink{out};
+    streamvbyte_encode(in, sink);
+}
+/**
+ * @brief Stream VByte 解码 out.size() 个数
+ * @return 消耗的字节数, 数据不完整时返回 0
+ */
+inline size_t streamvbyte_decode(std::span<const std::byte> in, std::span<uint32_t> out) noexcept {
+    const size_t count     = out.size();
+    const size_t ctrl_size = (count + 3) / 4;
+    if (in.size() < ctrl_size) {
+        return 0;
+    }
+    const auto*      ctrl = reinterpret_cast<const uint8_t*>(in.data());
+    const std::byte* data = in.data() + ctrl_size;
+    const std::byte* end  = in.data() + in.size();
+    size_t           i    = 0;
+#if defined(__SSSE3__) || defined(__AVX2__)
+    // 每次读 16 字节, 需要保证不越界; 剩下的交给标量
+    for (; i + 4 <= count && data + 16 <= end; i += 4) {
+        const uint8_t c    = ctrl[i / 4];
+        const __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(detail::svb_shuffle_table[c].data()));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out.data() + i), _mm_shuffle_epi8(v, mask));
+        data += detail::svb_length_table[c];
+    }
+#endif
+    for (; i < count; i += 4) {
+        const size_t  n    = std::min<size_t>(4, count - i);
+        const uint8_t c    = ctrl[i / 4];
+        size_t        need = 0;
+        for (size_t j = 0; j < n; j++) {
+            need += (c >> (2 * j) & 3) + 1;
+        }
+        if (static_cast<size_t>(end - data) < need) {
+            return 0;
+        }
+        data = detail::svb_decode_scalar(c, data, out.data() + i, n);
+    }
+    return data - in.data();
+}
+inline size_t streamvbyte_decode(std::span<const std::byte> in, std::span<int32_t> out) noexcept {
+    auto       u    = std::span<uint32_t>{reinterpret_cast<uint32_t*>(out.data()), out.size()};
+    const auto used = streamvbyte_decode(in, u);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = zigzag_decode(u[i]);
+    }
+    return used;
+}
+
+/*
+列式批量序列化: 一组记录按成员逐列写出(SoA), 每列按类型选择编码
+  - 整数: 与前一个值的差 -> zigzag -> varint, 递增的 id、相近的数量都只占 1~2 字节
+  - 浮点: byte-shuffle, 先写所有值的最高字节(符号与指数), 再写次高字节..., 便于后续通用压缩
+  - 枚举/bool: 按该列最大值的位宽 bit-packing, 位宽至少为 1
+  - 其他(std::array、嵌套结构体): 逐个按定长格式写出
+格式: [varint 记录数][每列: 4 字节大端长度 + 数据]
+每种编码每条记录至少占 1 位, 解码前用第一列的长度限制记录数, 损坏的记录数不会导致巨量分配
+*/
+namespace columnar {
+    enum class column_kind { delta_varint, byte_shuffle, bit_packed, fixed };
+
+    template <typename M>
+    constexpr column_kind kind_of = std::is_enum_v<M> || std::is_same_v<M, bool> ? column_kind::bit_packed
+                                    : std::is_integral_v<M>                       ? column_kind::delta_varint
+                                    : std::is_floating_point_v<M> && requires { typename uint_of_size<sizeof(M)>::type; }
+                                        ? column_kind::byte_shuffle
+                                        : column_kind::fixed;
+
+    template <typename M>
+    struct packed_uint {
+        using type = std::make_unsigned_t<M>;
+    };
+    template <typename M>
+        requires std::is_enum_v<M>
+    struct packed_uint<M> {
+        using type = std::make_unsigned_t<std::underlying_type_t<M>>;
+    };
+    template <>
+    struct packed_uint<bool> {
+        using type = uint8_t;
+    };
+    template <typename M>
+    using packed_uint_t = typename packed_uint<M>::type;
+
+    template <size_t I, typename T>
+    decltype(auto) member_ref(T& obj) noexcept {
+        return reflect::visit_members(obj, [](auto&... m) -> decltype(auto) { return std::get<I>(std::tie(m...)); });
+    }
+
+    /**
+     * @brief 交换 x 的高位块与 y 的低位块, 是 8x8 字节转置的一步
+     */
+    inline void transpose_step(uint64_t& x, uint64_t& y, unsigned shift, uint64_t mask) noexcept {
+        const uint64_t t = ((x >> shift) ^ y) & mask;
+        x ^= t << shift;
+        y ^= t;
+    }
+
+    /**
+     * @brief 把 8 个 64 位字看作 8x8 字节矩阵(w<i> 的第 j 个字节为第 i 行第 j 列)原地转置
+     *
+     * 8 个字分开传引用而不用数组, 内联后都留在寄存器里; 用数组时 GCC -O2 不展开循环, 每一步都要读写栈
+     */
+    inline void transpose_bytes_8x8(uint64_t& w0, uint64_t& w1, uint64_t& w2, uint64_t& w3, uint64_t& w4, uint64_t& w5, uint64_t& w6,
+                                    uint64_t& w7) noexcept {
+        // 依次交换 4x4、2x2、1x1 的子块
+        transpose_step(w0, w4, 32, 0x00000000FFFFFFFF), transpose_step(w1, w5, 32, 0x00000000FFFFFFFF);
+        transpose_step(w2, w6, 32, 0x00000000FFFFFFFF), transpose_step(w3, w7, 32, 0x00000000FFFFFFFF);
+        transpose_step(w0, w2, 16, 0x0000FFFF0000FFFF), transpose_step(w1, w3, 16, 0x0000FFFF0000FFFF);
+        transpose_step(w4, w6, 16, 0x0000FFFF0000FFFF), transpose_step(w5, w7, 16, 0x0000FFFF0000FFFF);
+        transpose_step(w0, w1, 8, 0x00FF00FF00FF00FF), transpose_step(w2, w3, 8, 0x00FF00FF00FF00FF);
+        transpose_step(w4, w5, 8, 0x00FF00FF00FF00FF), transpose_step(w6, w7, 8, 0x00FF00FF00FF00FF);
+    }
+
+    /**
+     * @brief len 字节的一列最多能容纳多少条记录
+     */
+    template <typename M>
+    constexpr size_t max_records(size_t len) {
+        if constexpr (kind_of<M> == column_kind::delta_varint) {
+            return len;
+        } else if constexpr (kind_of<M> == column_kind::bit_packed) {
+            return len == 0 ? 0 : (len - 1) * 8;
+        } else {
+            return len / sizeof(M);
+        }
+    }
+
+    //! 列长度用 4 字节记录, 一列的数据不能超过这么多字节
+    inline constexpr size_t max_column_bytes = std::numeric_limits<uint32_t>::max();
+
+    /**
+     * @brief 一次最多能按列写出多少条记录: 按最坏情况 (max_payload) 估计, 保证这一列的长度放得进 4 字节
+     */
+    template <typename M>
+    constexpr size_t max_batch_records() {
+        if constexpr (kind_of<M> == column_kind::delta_varint) {
+            return max_column_bytes / max_varint_size<std::make_unsigned_t<M>>;
+        } else if constexpr (kind_of<M> == column_kind::bit_packed) {
+            return (max_column_bytes - 1) / sizeof(M);
+        } else {
+            return max_column_bytes / sizeof(M);
+        }
+    }
+
+    template <typename M>
+    constexpr size_t max_payload(size_t count) {
+        if constexpr (kind_of<M> == column_kind::delta_varint) {
+            return count * max_varint_size<std::make_unsigned_t<M>>;
+        } else if constexpr (kind_of<M> == column_kind::bit_packed) {
+            return 1 + count * sizeof(M);
+        } else {
+            return count * sizeof(M);
+        }
+    }
+
+    /**
+     * @brief 编码一列, get(j) 返回第 j 条记录的该成员
+     * @return 写入的字节数
+     */
+    template <typename M, typename Get>
+    size_t encode_column(size_t count, Get get, std::byte* out) {
+        if constexpr (kind_of<M> == column_kind::delta_varint) {
+            using U         = std::make_unsigned_t<M>;
+            U          prev = 0;
+            std::byte* p    = out;
+            for (size_t j = 0; j < count; j++) {
+                const auto v = static_cast<U>(get(j));
+                p += varint_encode(zigzag_encode(static_cast<std::make_signed_t<U>>(static_cast<U>(v - prev))), p);
+                prev = v;
+            }
+            return p - out;
+        } else if constexpr (kind_of<M> == column_kind::byte_shuffle) {
+            using U = typename uint_of_size<sizeof(M)>::type;
+            for (size_t j = 0; j < count; j++) {
+                const auto u = std::bit_cast<U>(get(j));
+                for (size_t b = 0; b < sizeof(M); b++) {
+                    out[b * count + j] = static_cast<std::byte>(u >> (8 * (sizeof(M) - 1 - b)));
+                }
+            }
+            return count * sizeof(M);
+        } else if constexpr (kind_of<M> == column_kind::bit_packed) {
+            using U    = packed_uint_t<M>;
+            U all_bits = 0;
+            for (size_t j = 0; j < count; j++) {
+                all_bits |= static_cast<U>(get(j));
+            }
+            const unsigned width = std::max(1u, static_cast<unsigned>(std::bit_width(all_bits)));
+            const size_t   bytes = (count * width + 7) / 8;
+            out[0]               = static_cast<std::byte>(width);
+            memset(out + 1, 0, bytes);
+            size_t bit = 0;
+            for (size_t j = 0; j < count; j++) {
+                const uint64_t v = static_cast<U>(get(j));
+                for (unsigned k = 0; k < width;) {
+                    const unsigned off  = bit % 8;
+                    const unsigned take = std::min(8 - off, width - k);
+                    out[1 + bit / 8] |= static_cast<std::byte>((v >> k & ((1u << take) - 1)) << off);
+                    k += take;
+                    bit += take;
+                }
+            }
+            return 1 + bytes;
+        } else {
+            for (size_t j = 0; j < count; j++) {
+                encode_fixed(get(j), out + j * sizeof(M));
+            }
+            return count * sizeof(M);
+        }
+    }
+
+    //! deserialize_columns 分块解码时每块的记录数, 一块记录通常能留在 L1/L2 缓存中
+    inline constexpr size_t decode_block = 256;
+
+    /**
+     * @brief 一列的解码器: 构造时检查数据长度, 之后按记录下标递增的顺序分段解码
+     *
+     * 分段是为了让记录数组(AoS)解码可以按块轮流解码各列, 一块记录留在缓存里被所有列写完再换下一块;
+     * 差分 varint 列只能顺序解码, 各段必须首尾相接
+     */
+    template <typename M>
+    class column_decoder {
+    public:
+        //! 数据不完整时抛出 std::out_of_range
+        column_decoder(std::span<const std::byte> in, size_t count)
+            : p_(in.data()), end_(in.data() + in.size()), count_(count) {
+            if constexpr (kind_of<M> == column_kind::byte_shuffle || kind_of<M> == column_kind::fixed) {
+                if (in.size() / sizeof(M) < count) {
+                    truncated();
+                }
+            } else if constexpr (kind_of<M> == column_kind::bit_packed) {
+                if (in.empty()) {
+                    truncated();
+                }
+                width_ = static_cast<unsigned>(in[0]);
+                if (width_ == 0 || width_ > sizeof(U) * 8 || (in.size() - 1) * 8 / width_ < count) {
+                    truncated();
+                }
+                ++p_;
+            }
+        }
+
+        /**
+         * @brief 解码下标 [begin, end) 的记录, 通过 set(j, value) 写回
+         */
+        template <typename Set>
+        void decode(size_t begin, size_t end, Set set) {
+            if constexpr (kind_of<M> == column_kind::delta_varint) {
+                for (size_t j = begin; j < end;) {
+                    // 快速路径: 接下来 8 个字节都没有延续位时就是 8 个单字节的值, 一次读取, 逐字节累加
+                    if (end - j >= 8 && end_ - p_ >= 8) {
+                        uint64_t word;
+                        memcpy(&word, p_, 8);
+                        if constexpr (!is_system_little_endian) {
+                            word = std::byteswap(word);
+                        }
+                        if ((word & 0x8080808080808080) == 0) {
+                            for (size_t k = 0; k < 8; k++) {
+                                prev_ += static_cast<U>(zigzag_decode(static_cast<U>(word >> (8 * k) & 0xFF)));
+                                set(j + k, static_cast<M>(prev_));
+                            }
+                            p_ += 8;
+                            j += 8;
+                            continue;
+                        }
+                    }
+                    U z;
+                    if ((p_ = varint_decode(p_, end_, z)) == nullptr) {
+                        truncated();
+                    }
+                    prev_ += static_cast<U>(zigzag_decode(z));
+                    set(j++, static_cast<M>(prev_));
+                }
+            } else if constexpr (kind_of<M> == column_kind::byte_shuffle) {
+                // 每 8 条记录一组: 从每个字节平面各读 8 字节, 做一次 8x8 字节转置得到 8 个值, 不再逐字节拼装
+                size_t j = begin;
+                for (; j + 8 <= end; j += 8) {
+                    const auto plane = [&](size_t b) {
+                        uint64_t w = 0;
+                        if (b < sizeof(M)) {
+                            memcpy(&w, p_ + b * count_ + j, 8);
+                            if constexpr (!is_system_little_endian) {
+                                w = std::byteswap(w);
+                            }
+                        }
+                        return w;
+                    };
+                    const auto put = [&](size_t k, uint64_t w) {
+                        set(j + k, std::bit_cast<M>(static_cast<U>(std::byteswap(w) >> (8 * (8 - sizeof(M))))));
+                    };
+                    uint64_t w0 = plane(0), w1 = plane(1), w2 = plane(2), w3 = plane(3);
+                    uint64_t w4 = plane(4), w5 = plane(5), w6 = plane(6), w7 = plane(7);
+                    transpose_bytes_8x8(w0, w1, w2, w3, w4, w5, w6, w7);
+                    put(0, w0), put(1, w1), put(2, w2), put(3, w3), put(4, w4), put(5, w5), put(6, w6), put(7, w7);
+                }
+                for (; j < end; j++) {
+                    U u = 0;
+                    for (size_t b = 0; b < sizeof(M); b++) {
+                        u = static_cast<U>(u << 8 | static_cast<uint8_t>(p_[b * count_ + j]));
+                    }
+                    set(j, std::bit_cast<M>(u));
+                }
+            } else if constexpr (kind_of<M> == column_kind::bit_packed) {
+                const size_t   bytes = static_cast<size_t>(end_ - p_);
+                const uint64_t mask  = width_ == 64 ? ~uint64_t{0} : (uint64_t{1} << width_) - 1;
+                size_t         bit   = begin * width_;
+                size_t         j     = begin;
+                // 位宽不超过 57 时, 每个值都落在从 bit / 8 开始的 8 个字节内, 一次未对齐读取即可取出
+                if (width_ <= 57) {
+                    for (; j < end && bit / 8 + 8 <= bytes; j++, bit += width_) {
+                        uint64_t word;
+                        memcpy(&word, p_ + bit / 8, 8);
+                        if constexpr (!is_system_little_endian) {
+                            word = std::byteswap(word);
+                        }
+                        set(j, static_cast<M>(static_cast<U>(word >> (bit % 8) & mask)));
+                    }
+                }
+                for (; j < end; j++) {
+                    uint64_t v = 0;
+                    for (unsigned k = 0; k < width_;) {
+                        const unsigned off  = bit % 8;
+                        const unsigned take = std::min(8 - off, width_ - k);
+                        v |= static_cast<uint64_t>(static_cast<uint8_t>(p_[bit / 8]) >> off & ((1u << take) - 1)) << k;
+                        k += take;
+                        bit += take;
+                    }
+                    set(j, static_cast<M>(static_cast<U>(v)));
+                }
+            } else {
+                for (size_t j = begin; j < end; j++) {
+                    M v;
+                    decode_fixed(p_ + j * sizeof(M), v);
+                    set(j, v);
+                }
+            }
+        }
+
+    private:
+        using U = typename std::conditional_t<
+            kind_of<M> == column_kind::delta_varint, std::make_unsigned<M>,
+            std::conditional_t<kind_of<M> == column_kind::byte_shuffle, uint_of_size<sizeof(M)>,
+                               std::conditional_t<kind_of<M> == column_kind::bit_packed, packed_uint<M>, std::type_identity<void>>>>::type;
+
+        [[noreturn]] static void truncated() { throw std::out_of_range("deserialize_columns: truncated column"); }
+
+        const std::byte* p_;       // 差分 varint: 下一个未读字节; 其他: 数据起点(bit-packing 跳过位宽字节)
+        const std::byte* end_;
+        size_t           count_;
+        unsigned         width_ = 0; // bit-packing 的位宽
+        std::conditional_t<kind_of<M> == column_kind::delta_varint, U, char> prev_{};
+    };
+
+    // 按列遍历 T 的成员: f(std::integral_constant<size_t, I>, std::type_identity<M>)
+    template <typename T, typename F>
+    void for_each_column(F&& f) {
+        [&]<typename... Ms, size_t... I>(std::type_identity<std::tuple<Ms...>>, std::index_sequence<I...>) {
+            (f(std::integral_constant<size_t, I>{}, std::type_identity<Ms>{}), ...);
+        }(std::type_identity<member_types_t<T>>{}, std::make_index_sequence<reflect::members_count_v<T>>{});
+    }
+
+    template <typename T>
+    using column_spans = std::array<std::span<const std::byte>, reflect::members_count_v<T>>;
+
+    /**
+     * @brief 读取记录数和每一列的数据范围
+     *
+     * 记录数来自不可信的输入, 返回 (进而 resize) 之前先检查每一列的长度都放得下这么多条记录
+     *
+     * @return 记录数
+     */
+    template <typename T>
+    size_t read_columns(std::span<const std::byte> in, column_spans<T>& cols) {
+        uint64_t         count;
+        const std::byte* p   = varint_decode(in.data(), in.data() + in.size(), count);
+        const std::byte* end = in.data() + in.size();
+        if (p == nullptr) {
+            throw std::out_of_range("deserialize_columns: missing record count");
+        }
+        for_each_column<T>([&]<size_t I, typename M>(std::integral_constant<size_t, I>, std::type_identity<M>) {
+            if (end - p < 4) {
+                throw std::out_of_range("deserialize_columns: missing column length");
+            }
+            uint32_t len;
+            memcpy(&len, p, 4);
+            len = byteswap(len);
+            p += 4;
+            if (static_cast<size_t>(end - p) < len) {
+                throw std::out_of_range("deserialize_columns: truncated column");
+            }
+            if (count > max_records<M>(len)) {
+                throw std::out_of_range("deserialize_columns: record count exceeds column data");
+            }
+            cols[I] = std::span<const std::byte>{p, len};
+            p += len;
+        });
+        return static_cast<size_t>(count);
+    }
+} // namespace columnar
+
+template <typename T>
+concept columnar_record = is_fixed_wire_v<T> && !wire_scalar<T> && !is_std_array<T>::value;
+
+/**
+ * @brief 按列写出 records, 每列最多 columnar::max_batch_records 条记录
+ */
+template <columnar_record T, byte_sink S>
+void serialize_columns(std::span<const T> records, S& sink) {
+    // 写出任何数据之前检查, 超出时抛出 std::length_error, 调用方应拆成多批
+    columnar::for_each_column<T>([&]<size_t I, typename M>(std::integral_constant<size_t, I>, std::type_identity<M>) {
+        if (records.size() > columnar::max_batch_records<M>()) {
+            throw std::length_error("serialize_columns: column exceeds 4 GiB, split the batch");
+        }
+    });
+    std::byte* head = sink.reserve(max_varint_size<uint64_t>);
+    sink.commit(varint_encode(static_cast<uint64_t>(records.size()), head));
+    columnar::for_each_column<T>([&]<size_t I, typename M>(std::integral_constant<size_t, I>, std::type_identity<M>) {
+        std::byte*     p   = sink.reserve(4 + columnar::max_payload<M>(records.size()));
+        const uint32_t len = static_cast<uint32_t>(
+            columnar::encode_column<M>(records.size(), [&](size_t j) -> M { return columnar::member_ref<I>(records[j]); }, p + 4));
+        const uint32_t be_len = byteswap(len);
+        memcpy(p, &be_len, 4);
+        sink.commit(4 + len);
+    });
+}
+template <columnar_record T>
+std::vector<std::byte> serialize_columns(std::span<const T> records) {
+    std::vector<std::byte> res;
+    vector_sink            sink{res};
+    serialize_columns(records, sink);
+    return res;
+}
+
+/**
+ * @brief 解码为记录数组(AoS)
+ *
+ * 按 columnar::decode_block 条记录分块, 每块依次解码所有列, 块内的记录在缓存中被各列写完再处理下一块,
+ * 不必为每一列把整个数组从内存读写一遍.
+ *
+ * 注意: 这没有达到"比逐条记录更快的批量解码". 列式解码每个值都要做差分累加、字节转置或位提取,
+ * 还要写一个新分配的结果数组; bench 的 scalar 形状上本函数约 8 ns/记录, deserialize_columns_soa 约 6 ns/记录,
+ * 定长格式约 2 ns/记录 (后者反复解码到同一个对象, 不写数组). 列式格式换来的是更小的体积 (约 9 字节/记录, 定长 24 字节)
+ */
+template <columnar_record T>
+std::vector<T> deserialize_columns(std::span<const std::byte> in) {
+    columnar::column_spans<T> cols;
+    const size_t              count = columnar::read_columns<T>(in, cols);
+    auto decoders = [&]<typename... Ms, size_t... I>(std::type_identity<std::tuple<Ms...>>, std::index_sequence<I...>) {
+        return std::tuple<columnar::column_decoder<Ms>...>{columnar::column_decoder<Ms>{cols[I], count}...};
+    }(std::type_identity<member_types_t<T>>{}, std::make_index_sequence<reflect::members_count_v<T>>{});
+    std::vector<T> res(count);
+    for (size_t begin = 0; begin < count; begin += columnar::decode_block) {
+        const size_t end = std::min(count, begin + columnar::decode_block);
+        columnar::for_each_column<T>([&]<size_t I, typename M>(std::integral_constant<size_t, I>, std::type_identity<M>) {
+            std::get<I>(decoders).decode(begin, end, [&](size_t j, M v) { columnar::member_ref<I>(res[j]) = v; });
+        });
+    }
+    return res;
+}
+
+template <typename Tuple>
+struct soa_of;
+template <typename... Ms>
+struct soa_of<std::tuple<Ms...>> {
+    using type = std::tuple<std::vector<Ms>...>;
+};
+//! T 的列式表示: 每个成员一个 std::vector
+template <typename T>
+using soa_t = typename soa_of<member_types_t<T>>::type;
+
+/**
+ * @brief 解码为列(SoA), 不经过记录结构体
+ */
+template <columnar_record T>
+soa_t<T> deserialize_columns_soa(std::span<const std::byte> in) {
+    columnar::column_spans<T> cols;
+    const size_t              count = columnar::read_columns<T>(in, cols);
+    soa_t<T>                  res;
+    columnar::for_each_column<T>([&]<size_t I, typename M>(std::integral_constant<size_t, I>, std::type_identity<M>) {
+        columnar::column_decoder<M> decoder{cols[I], count};
+        auto&                       column = std::get<I>(res);
+        column.resize(count);
+        decoder.decode(0, count, [&](size_t j, M v) { column[j] = v; });
+    });
     return res;
+}
+
+/*
+变长类型: std::string、std::vector、std::array、std::optional、map 以及包含它们的结构体
+  - 字符串和容器: [varint 元素个数][元素...]
+  - optional:     [1 字节是否有值][值]
+  - map:          [varint 元素个数][key value ...]
+  - 结构体:       成员按声明顺序紧密排列, 没有填充
+元素是定长类型的连续容器(std::vector<int>、std::string、std::vector<Person>...)整体写出:
+标量元素一次 byteswap_span(大端机器上就是 memcpy), 结构体元素逐个 encode_fixed, 都不经过逐元素的递归
+*/
+template <typename T>
+struct is_optional : std::false_type {};
+template <typename E>
+struct is_optional<std::optional<E>> : std::true_type {};
+
+template <typename T>
+concept map_like = std::ranges::range<T> && requires {
+    typename T::key_type;
+    typename T::mapped_type;
+};
+template <typename T>
+concept sequence_like = std::ranges::sized_range<T> && requires(T& c, typename T::value_type v) {
+    c.clear();
+    c.push_back(std::move(v));
 };
+//! 元素为定长类型的连续容器, 可以整体拷贝 (std::vector<bool> 不是连续的)
+template <typename T>
+concept contiguous_fixed = std::ranges::contiguous_range<T> && sequence_like<T> && is_fixed_wire_v<std::ranges::range_value_t<T>> &&
+                           requires(T& c, size_t n) { c.resize(n); };
 
-Person deserialize(const std::vector<std::byte>& seq) {
-    Person           p;
-    const std::byte* ptr = seq.data();
-    p.a                  = byteswap(*(int*)ptr);
+namespace detail {
+    template <byte_sink S>
+    void write_size(S& sink, size_t n) {
+        sink.commit(varint_encode(static_cast<uint64_t>(n), sink.reserve(max_varint_size<uint64_t>)));
+    }
+    //! 超过这个大小并且不需要转换端序的数据, iovec_sink 直接引用而不拷贝
+    constexpr size_t ref_threshold = 4096;
+} // namespace detail
+
+/**
+ * @brief 变长类型追加到 sink
+ */
+template <typename T, byte_sink S>
+    requires(!is_fixed_wire_v<T>)
+void serialize_to(S& sink, const T& obj) {
+    if constexpr (contiguous_fixed<T>) {
+        using E = std::ranges::range_value_t<T>;
+        detail::write_size(sink, obj.size());
+        const size_t bytes = obj.size() * sizeof(E);
+        if constexpr (wire_scalar<E> && (sizeof(E) == 1 || !is_system_little_endian) && requires { sink.append_ref(obj.data(), bytes); }) {
+            if (bytes >= detail::ref_threshold) {
+                sink.append_ref(obj.data(), bytes);
+                return;
+            }
+        }
+        std::byte* p = sink.reserve(bytes);
+        if constexpr (wire_scalar<E> && value_bytes_v<E> == sizeof(E)) {
+            byteswap_span(std::span<const E>{obj.data(), obj.size()}, p);
+        } else {
+            for (size_t i = 0; i < obj.size(); i++) {
+                encode_fixed(obj[i], p + i * sizeof(E));
+            }
+        }
+        sink.commit(bytes);
+    } else if constexpr (is_optional<T>::value) {
+        *sink.reserve(1) = static_cast<std::byte>(obj.has_value());
+        sink.commit(1);
+        if (obj) {
+            serialize_to(sink, *obj);
+        }
+    } else if constexpr (map_like<T>) {
+        detail::write_size(sink, std::ranges::size(obj));
+        for (const auto& [k, v] : obj) {
+            serialize_to(sink, k);
+            serialize_to(sink, v);
+        }
+    } else if constexpr (sequence_like<T>) {
+        detail::write_size(sink, obj.size());
+        for (const auto& e : obj) {
+            serialize_to(sink, static_cast<const std::ranges::range_value_t<T>&>(e));
+        }
+    } else if constexpr (is_std_array<T>::value) {
+        for (const auto& e : obj) {
+            serialize_to(sink, e);
+        }
+    } else if constexpr (std::is_aggregate_v<T>) {
+        reflect::visit_members(obj, [&](const auto&... m) { (serialize_to(sink, m), ...); });
+    } else {
+        static_assert(sizeof(T) < 0, "type is not serializable");
+    }
+}
 
-    ptr += sizeof(p.a);
-    ptr = find_next_align<decltype(p.b)>(ptr);
-    p.b = byteswap(*(double*)ptr);
+template <typename T>
+    requires(!is_fixed_wire_v<T>)
+std::vector<std::byte> serialize(const T& obj) {
+    std::vector<std::byte> res;
+    vector_sink            sink{res};
+    serialize_to(sink, obj);
+    return res;
+}
 
-    ptr += sizeof(p.b);
-    ptr = find_next_align<decltype(p.c)>(ptr);
-    p.c = byteswap(*(char*)ptr);
+/**
+ * @brief 顺序读取输入, 越界时抛出 std::out_of_range
+ */
+class byte_reader {
+public:
+    explicit byte_reader(std::span<const std::byte> in) noexcept : p_(in.data()), end_(in.data() + in.size()) {}
 
-    return p;
+    const std::byte* take(size_t n) {
+        if (n > remaining()) {
+            throw std::out_of_range("deserialize: truncated input");
+        }
+        return std::exchange(p_, p_ + n);
+    }
+    /**
+     * @brief 读取元素个数; 每个元素至少占 1 字节, 所以个数不可能超过剩余字节数,
+     * 借此在 resize 之前拒绝损坏的数据
+     */
+    size_t read_size(size_t min_element_size = 1) {
+        uint64_t n;
+        if ((p_ = varint_decode(p_, end_, n)) == nullptr || n > remaining() / std::max<size_t>(min_element_size, 1)) {
+            throw std::out_of_range("deserialize: bad length");
+        }
+        return static_cast<size_t>(n);
+    }
+    size_t remaining() const noexcept { return end_ - p_; }
+
+private:
+    const std::byte* p_;
+    const std::byte* end_;
 };
+
+/**
+ * @brief 从 in 读取一个 T
+ */
+template <typename T>
+void deserialize_from(byte_reader& in, T& obj) {
+    if constexpr (is_fixed_wire_v<T>) {
+        decode_fixed(in.take(sizeof(T)), obj);
+    } else if constexpr (contiguous_fixed<T>) {
+        using E        = std::ranges::range_value_t<T>;
+        const size_t n = in.read_size(sizeof(E));
+        obj.resize(n);
+        const std::byte* p = in.take(n * sizeof(E));
+        if constexpr (wire_scalar<E> && value_bytes_v<E> == sizeof(E) && !std::is_same_v<E, bool>) {
+            byteswap_span(p, std::span<E>{obj.data(), n});
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                decode_fixed(p + i * sizeof(E), obj[i]);
+            }
+        }
+    } else if constexpr (is_optional<T>::value) {
+        const auto flag = static_cast<uint8_t>(*in.take(1));
+        if (flag > 1) {
+            throw std::out_of_range("deserialize: bad optional flag");
+        }
+        if (flag) {
+            deserialize_from(in, obj.emplace());
+        } else {
+            obj.reset();
+        }
+    } else if constexpr (map_like<T>) {
+        const size_t n = in.read_size();
+        obj.clear();
+        for (size_t i = 0; i < n; i++) {
+            typename T::key_type    k{};
+            typename T::mapped_type v{};
+            deserialize_from(in, k);
+            deserialize_from(in, v);
+            obj.emplace(std::move(k), std::move(v));
+        }
+    } else if constexpr (sequence_like<T>) {
+        const size_t n = in.read_size();
+        obj.clear();
+        for (size_t i = 0; i < n; i++) {
+            typename T::value_type v{};
+            deserialize_from(in, v);
+            obj.push_back(std::move(v));
+        }
+    } else if constexpr (is_std_array<T>::value) {
+        for (auto& e : obj) {
+            deserialize_from(in, e);
+        }
+    } else if constexpr (std::is_aggregate_v<T>) {
+        reflect::visit_members(obj, [&](auto&... m) { (deserialize_from(in, m), ...); });
+    } else {
+        static_assert(sizeof(T) < 0, "type is not deserializable");
+    }
+}
+
+template <typename T>
+    requires(!is_fixed_wire_v<T>)
+T deserialize(std::span<const std::byte> seq) {
+    byte_reader in{seq};
+    T           obj{};
+    deserialize_from(in, obj);
+    return obj;
+}
+
+/*
+记录流文件: [8 字节魔数 "SERREC01"][记录: 4 字节大端长度 + serialize 的输出]...
+写: 生产者线程只往内存缓冲区追加, 满了就和后台线程交换(双缓冲), 后台线程负责 write 和批量 fdatasync;
+    后台还在写上一块时生产者不等待, 当前缓冲区继续增长
+读: 整个文件 mmap, 迭代器直接返回指向映射内存的 std::span, 不拷贝
+*/
+constexpr std::string_view record_file_magic = "SERREC01";
+
+class record_file_writer {
+public:
+    /**
+     * @param flush_bytes   当前缓冲区达到这个大小后交给后台线程
+     * @param sync_interval 两次 fdatasync 的最短间隔, 期间写入的数据一起同步
+     */
+    explicit record_file_writer(const char* path, size_t flush_bytes = 1 << 20,
+                                std::chrono::milliseconds sync_interval = std::chrono::milliseconds{100})
+        : flush_bytes_(flush_bytes), sync_interval_(sync_interval) {
+        fd_ = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        memcpy(active_->reserve(record_file_magic.size()), record_file_magic.data(), record_file_magic.size());
+        active_->commit(record_file_magic.size());
+        appended_ = record_file_magic.size();
+        thread_ = std::thread([this] { run(); });
+    }
+    record_file_writer(const record_file_writer&)            = delete;
+    record_file_writer& operator=(const record_file_writer&) = delete;
+    ~record_file_writer() {
+        flush();
+        {
+            std::lock_guard lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        ::close(fd_);
+    }
+
+    /**
+     * @brief 追加一条记录, 不做任何 I/O
+     */
+    template <typename T>
+    void write(const T& record) {
+        const size_t start = active_->bytes().size();
+        active_->reserve(4);
+        active_->commit(4);
+        serialize_to(*active_, record);
+        const uint32_t len = byteswap(static_cast<uint32_t>(active_->bytes().size() - start - 4));
+        memcpy(active_->data() + start, &len, 4);
+        appended_ += active_->bytes().size() - start;
+        if (active_->bytes().size() >= flush_bytes_) {
+            try_handoff();
+        }
+    }
+    /**
+     * @brief 把已写入的记录全部落盘(write + fdatasync), 会阻塞直到完成
+     */
+    void flush() {
+        std::unique_lock lock(mtx_);
+        cv_.wait(lock, [this] { return pending_ == nullptr; });
+        if (!active_->bytes().empty()) {
+            pending_ = std::exchange(active_, other(active_));
+        }
+        // 取一张票, 后台线程在这之后开始的一次同步完成时才会把 sync_done_ 推进到它
+        const uint64_t ticket = ++sync_requested_;
+        cv_.notify_all();
+        cv_.wait(lock, [&] { return sync_done_ >= ticket; });
+    }
+    //! 后台线程遇到的第一个错误码, 0 表示没有错误
+    int error() const noexcept { return error_.load(std::memory_order_relaxed); }
+    //! 已追加的字节数(含文件头), 只能在生产者线程调用
+    uint64_t appended_bytes() const noexcept { return appended_; }
+    //! 已经 fdatasync 落盘的字节数(含文件头)
+    uint64_t synced_bytes() const noexcept { return synced_.load(std::memory_order_acquire); }
+
+private:
+    arena_sink* other(arena_sink* b) noexcept { return b == &buffers_[0] ? &buffers_[1] : &buffers_[0]; }
+
+    // 后台线程空闲时交换缓冲区, 否则什么也不做, 继续写当前缓冲区
+    void try_handoff() {
+        std::unique_lock lock(mtx_, std::try_to_lock);
+        if (!lock.owns_lock() || pending_ != nullptr) {
+            return;
+        }
+        pending_ = std::exchange(active_, other(active_));
+        cv_.notify_all();
+    }
+
+    void run() {
+        using clock = std::chrono::steady_clock;
+        auto             last     = clock::now();
+        size_t           unsynced = 0;
+        uint64_t         written  = 0;
+        std::unique_lock lock(mtx_);
+        while (true) {
+            cv_.wait_for(lock, sync_interval_, [this] { return pending_ != nullptr || sync_requested_ != sync_done_ || stop_; });
+            // 此刻之前取票的 flush() 都已经交出了数据(就在 pending_ 里), 本轮写完并同步后只完成这些票;
+            // 解锁同步期间新取的票留到下一轮
+            const uint64_t requested = sync_requested_;
+            if (pending_ != nullptr) {
+                arena_sink* buf = pending_;
+                lock.unlock();
+                write_all(buf->bytes());
+                unsynced += buf->bytes().size();
+                written += buf->bytes().size();
+                buf->clear();
+                lock.lock();
+                pending_ = nullptr;
+            }
+            const bool due = clock::now() - last >= sync_interval_;
+            if (unsynced > 0 && (due || requested != sync_done_)) {
+                lock.unlock();
+                if (::fdatasync(fd_) < 0) {
+                    set_error(errno);
+                } else {
+                    synced_.store(written, std::memory_order_release);
+                }
+                lock.lock();
+                unsynced = 0;
+                last     = clock::now();
+            }
+            sync_done_ = requested;
+            cv_.notify_all();
+            if (stop_ && pending_ == nullptr) {
+                return;
+            }
+        }
+    }
+    void write_all(std::span<const std::byte> data) {
+        while (!data.empty()) {
+            const ssize_t n = ::write(fd_, data.data(), data.size());
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                set_error(errno);
+                return;
+            }
+            data = data.subspan(static_cast<size_t>(n));
+        }
+    }
+    void set_error(int err) noexcept {
+        int expected = 0;
+        error_.compare_exchange_strong(expected, err, std::memory_order_relaxed);
+    }
+
+    int                       fd_ = -1;
+    size_t                    flush_bytes_;
+    std::chrono::milliseconds sync_interval_;
+    arena_sink                buffers_[2];
+    arena_sink*               active_         = &buffers_[0]; //!< 只由生产者访问
+    uint64_t                  appended_       = 0;            //!< 只由生产者访问
+    arena_sink*               pending_        = nullptr;      //!< 交给后台线程的缓冲区, 写完后置空
+    uint64_t                  sync_requested_ = 0;            //!< flush() 发出的票号
+    uint64_t                  sync_done_      = 0;            //!< 已完成(写入并同步)的最大票号
+    bool                      stop_           = false;
+    std::atomic<int>          error_{0};
+    std::atomic<uint64_t>     synced_{0};
+    std::mutex                mtx_;
+    std::condition_variable   cv_;
+    std::thread               thread_;
+};
+
+class record_file_reader {
+public:
+    explicit record_file_reader(const char* path) {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) < 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), path);
+            }
+            data_ = static_cast<const std::byte*>(p);
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        if (size_ < record_file_magic.size() || memcmp(data_, record_file_magic.data(), record_file_magic.size()) != 0) {
+            if (data_ != nullptr) {
+                ::munmap(const_cast<std::byte*>(data_), size_);
+            }
+            throw std::runtime_error("record_file_reader: not a record stream file");
+        }
+    }
+    record_file_reader(const record_file_reader&)            = delete;
+    record_file_reader& operator=(const record_file_reader&) = delete;
+    ~record_file_reader() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<std::byte*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    /**
+     * @brief 逐条返回记录内容, 指向映射内存; 记录被截断时抛出 std::out_of_range
+     */
+    class iterator {
+    public:
+        using value_type      = std::span<const std::byte>;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        iterator(const std::byte* p, const std::byte* end) : p_(p), end_(end) { load(); }
+
+        value_type operator*() const noexcept { return cur_; }
+        iterator&  operator++() {
+            p_ = cur_.data() + cur_.size();
+            load();
+            return *this;
+        }
+        iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const iterator& o) const noexcept { return p_ == o.p_; }
+
+    private:
+        void load() {
+            if (p_ == end_) {
+                return;
+            }
+            uint32_t len;
+            if (end_ - p_ < 4 || (memcpy(&len, p_, 4), len = byteswap(len), static_cast<size_t>(end_ - p_ - 4) < len)) {
+                throw std::out_of_range("record_file_reader: truncated record");
+            }
+            cur_ = {p_ + 4, len};
+        }
+
+        const std::byte* p_   = nullptr;
+        const std::byte* end_ = nullptr;
+        value_type       cur_;
+    };
+
+    iterator begin() const { return {data_ + record_file_magic.size(), data_ + size_}; }
+    iterator end() const { return {data_ + size_, data_ + size_}; }
+
+private:
+    const std::byte* data_ = nullptr;
+    size_t           size_ = 0;
+};
+
+struct Person {
+    int    a;
+    double b;
+    char   c;
+
+    bool operator==(const Person&) const = default;
+};
+
+// 统计堆分配次数, 用于验证 sink 在稳定状态下不分配内存
+std::atomic<size_t> g_alloc_count{0};
+void*               operator new(size_t n) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
 void print(const Person& p) {
     std::cout << p.a << '\t' << p.b << '\t' << p.c << '\n';
 }
-int main() {
+/*
+序列化性能测试: 对不同形状的记录集合, 测每种可用编码的编码/解码 MB/s、ns/record、bytes/record 和每条记录的堆分配次数,
+结果以 JSON 输出, 便于做回归对比
+*/
+namespace bench {
+    enum class Side : uint8_t { Buy, Sell, Cancel };
+    //! 纯标量
+    struct ScalarRecord {
+        int64_t id;
+        double  price;
+        Side    side;
+    };
+    //! 以字符串为主
+    struct StringRecord {
+        int32_t     id;
+        std::string name;
+        std::string email;
+    };
+    //! 嵌套数组
+    struct NestedRecord {
+        int32_t             id;
+        std::vector<double> samples;
+        std::vector<Person> items;
+    };
+
+    std::vector<ScalarRecord> make_scalar(size_t n) {
+        std::vector<ScalarRecord> v(n);
+        for (size_t i = 0; i < n; i++) {
+            v[i] = {static_cast<int64_t>(1'000'000 + i * 3), 100.0 + (i % 64) * 0.25, static_cast<Side>(i % 3)};
+        }
+        return v;
+    }
+    std::vector<StringRecord> make_string(size_t n) {
+        std::vector<StringRecord> v(n);
+        for (size_t i = 0; i < n; i++) {
+            v[i] = {static_cast<int32_t>(i), "user_" + std::to_string(i) + std::string(i % 24, 'x'), "user" + std::to_string(i) + "@example.com"};
+        }
+        return v;
+    }
+    std::vector<NestedRecord> make_nested(size_t n) {
+        std::vector<NestedRecord> v(n);
+        for (size_t i = 0; i < n; i++) {
+            v[i].id = static_cast<int32_t>(i);
+            v[i].samples.assign(16 + i % 48, i * 0.5);
+            v[i].items.assign(i % 8, Person{static_cast<int>(i), i * 1.5, 'p'});
+        }
+        return v;
+    }
+    std::vector<int32_t> make_ints(size_t n) {
+        std::vector<int32_t> v(n);
+        for (size_t i = 0; i < n; i++) {
+            v[i] = i % 97 == 0 ? static_cast<int32_t>(i * 2654435761u) : static_cast<int32_t>(i % 300) - 150;
+        }
+        return v;
+    }
+
+    struct Result {
+        std::string_view shape, mode;
+        size_t           records, bytes;
+        double           encode_s, decode_s;
+        double           encode_allocs, decode_allocs;
+    };
+
+    //! 防止解码结果被优化掉
+    volatile uint64_t g_sink = 0;
+
+    /**
+     * @brief encode(arena) 把全部记录编码到 arena, decode(bytes) 解码全部记录;
+     * 各运行 trials 次取最快, 第一次运行之后才统计分配次数(与 sink 的稳定状态一致)
+     */
+    template <typename Encode, typename Decode>
+    Result measure(std::string_view shape, std::string_view mode, size_t records, Encode encode, Decode decode, int trials = 5) {
+        using clock = std::chrono::steady_clock;
+        arena_sink arena;
+        Result     r{shape, mode, records, 0, 1e30, 1e30, 0, 0};
+        for (int t = 0; t < trials; t++) {
+            arena.clear();
+            const size_t a0 = g_alloc_count;
+            const auto   t0 = clock::now();
+            encode(arena);
+            const auto   t1 = clock::now();
+            const size_t a1 = g_alloc_count;
+            decode(arena.bytes());
+            const auto   t2 = clock::now();
+            const size_t a2 = g_alloc_count;
+            r.bytes         = arena.bytes().size();
+            r.encode_s      = std::min(r.encode_s, std::chrono::duration<double>(t1 - t0).count());
+            r.decode_s      = std::min(r.decode_s, std::chrono::duration<double>(t2 - t1).count());
+            if (t == trials - 1) {
+                r.encode_allocs = double(a1 - a0) / records;
+                r.decode_allocs = double(a2 - a1) / records;
+            }
+        }
+        return r;
+    }
+
+    // 逐条记录: serialize_to / deserialize_from
+    template <typename T>
+    Result measure_records(std::string_view shape, const std::vector<T>& data) {
+        return measure(
+            shape, is_fixed_wire_v<T> ? "fixed" : "record", data.size(),
+            [&](arena_sink& a) {
+                for (const auto& x : data) {
+                    serialize_to(a, x);
+                }
+            },
+            [&](std::span<const std::byte> in) {
+                byte_reader reader{in};
+                T           obj{};
+                for (size_t i = 0; i < data.size(); i++) {
+                    deserialize_from(reader, obj);
+                }
+                g_sink = g_sink + reinterpret_cast<const uint8_t*>(&obj)[0];
+            });
+    }
+
+    void print_json(std::ostream& os, const std::vector<Result>& results) {
+        os << "{\"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const auto&  r  = results[i];
+            const double mb = r.bytes / 1e6;
+            os << "  {\"shape\": \"" << r.shape << "\", \"mode\": \"" << r.mode << "\", \"records\": " << r.records
+               << ", \"bytes_per_record\": " << double(r.bytes) / r.records << ", \"encode_mb_s\": " << mb / r.encode_s
+               << ", \"decode_mb_s\": " << mb / r.decode_s << ", \"encode_ns_per_record\": " << r.encode_s * 1e9 / r.records
+               << ", \"decode_ns_per_record\": " << r.decode_s * 1e9 / r.records << ", \"encode_allocs_per_record\": " << r.encode_allocs
+               << ", \"decode_allocs_per_record\": " << r.decode_allocs << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+        }
+        os << "]}\n";
+    }
+
+    void run_all(std::ostream& os, size_t n = 200000) {
+        std::vector<Result> results;
+
+        const auto scalar = make_scalar(n);
+        results.push_back(measure_records("scalar", scalar));
+        results.push_back(measure(
+            "scalar", "view", n,
+            [&](arena_sink& a) {
+                for (const auto& x : scalar) {
+                    serialize_to(a, x);
+                }
+            },
+            [&](std::span<const std::byte> in) {
+                // 只读取一个字段
+                int64_t sum = 0;
+                for (size_t i = 0; i < n; i++) {
+                    sum += serialized_view<ScalarRecord>{in.subspan(i * sizeof(ScalarRecord))}.get<0>();
+                }
+                g_sink = g_sink + sum;
+            }));
+        results.push_back(measure(
+            "scalar", "columnar", n, [&](arena_sink& a) { serialize_columns(std::span<const ScalarRecord>{scalar}, a); },
+            [&](std::span<const std::byte> in) { g_sink = g_sink + deserialize_columns<ScalarRecord>(in).size(); }));
+        results.push_back(measure(
+            "scalar", "columnar_soa", n, [&](arena_sink& a) { serialize_columns(std::span<const ScalarRecord>{scalar}, a); },
+            [&](std::span<const std::byte> in) { g_sink = g_sink + std::get<0>(deserialize_columns_soa<ScalarRecord>(in)).size(); }));
+
+        results.push_back(measure_records("string", make_string(n)));
+        results.push_back(measure_records("nested", make_nested(n / 10)));
+
+        const auto           ints = make_ints(n);
+        std::vector<int32_t> out(ints.size());
+        results.push_back(measure(
+            "int_array", "fixed", n, [&](arena_sink& a) { serialize_to(a, ints); },
+            [&](std::span<const std::byte> in) {
+                byte_reader reader{in};
+                deserialize_from(reader, out);
+            }));
+        results.push_back(measure(
+            "int_array", "varint", n, [&](arena_sink& a) { encode_varints(std::span<const int32_t>{ints}, a); },
+            [&](std::span<const std::byte> in) { g_sink = g_sink + decode_varints(in, std::span{out}); }));
+        results.push_back(measure(
+            "int_array", "streamvbyte", n, [&](arena_sink& a) { streamvbyte_encode(std::span<const int32_t>{ints}, a); },
+            [&](std::span<const std::byte> in) { g_sink = g_sink + streamvbyte_decode(in, std::span{out}); }));
+
+        print_json(os, results);
+    }
+} // namespace bench
+
+int main(int argc, char** argv) {
+    // serialize2 --bench: 只运行性能测试并输出 JSON
+    if (argc >= 2 && std::string_view{argv[1]} == "--bench") {
+        bench::run_all(std::cout);
+        return 0;
+    }
     Person p{.a = 1, .b = 2.3, .c = 'f'};
     auto   bytes = serialize(p);
-    auto   p2    = deserialize(bytes);
+    auto   p2    = deserialize<Person>(bytes);
     print(p);
     print(p2);
-}
+
+    // 嵌套结构体、std::array、枚举
+    enum class Kind : uint16_t { A = 1, B = 0x0203 };
+    struct Packet {
+        Person                  who;
+        std::array<uint32_t, 5> ids;
+        Kind                    kind;
+        bool operator==(const Packet&) const = default;
+    };
+    const Packet pk{p, {1, 2, 3, 0x01020304, 5}, Kind::B};
+    const auto   pk_bytes = serialize(pk);
+    if (deserialize<Packet>(pk_bytes) != pk || pk_bytes[3] != std::byte{1} || pk_bytes[4] != std::byte{0} || pk_bytes[24 + 12] != std::byte{1} ||
+        std::any_of(bytes.begin() + 4, bytes.begin() + 8, [](std::byte b) { return b != std::byte{0}; })) {
+        std::cerr << "reflection serializer mismatch\n";
+        return -1;
+    }
+    const serialized_view<Packet> pk_view{pk_bytes};
+    if (pk_view.get<0>().get<1>() != p.b || pk_view.get<1>()[3] != 0x01020304 || pk_view.get<2>() != Kind::B || pk_view.load() != pk) {
+        std::cerr << "serialized_view mismatch\n";
+        return -1;
+    }
+
+    // sink: 第一轮之后 arena 不再分配内存
+    arena_sink                arena;
+    const std::vector<Packet> packets(1000, pk);
+    for (int round = 0; round < 3; round++) {
+        arena.clear();
+        const size_t before = g_alloc_count;
+        for (const auto& x : packets) {
+            serialize_to(arena, x);
+        }
+        if (round > 0 && g_alloc_count != before) {
+            std::cerr << "arena_sink allocated in steady state\n";
+            return -1;
+        }
+    }
+    std::array<std::byte, sizeof(Packet) * 2> fixed_buf;
+    fixed_sink                                fixed{fixed_buf};
+    serialize_to(fixed, pk);
+    serialize_to(fixed, pk);
+    try {
+        serialize_to(fixed, pk);
+        std::cerr << "fixed_sink overflow not detected\n";
+        return -1;
+    } catch (const std::length_error&) {
+    }
+    iovec_sink             iov;
+    const std::string_view tail = "zero-copy tail";
+    serialize_to(iov, pk);
+    iov.append_ref(tail.data(), tail.size());
+    serialize_to(iov, pk);
+    std::FILE*             tmp = std::tmpfile();
+    std::vector<std::byte> written(iov.size());
+    if (tmp == nullptr || !iov.write_to(fileno(tmp)) || std::fseek(tmp, 0, SEEK_SET) != 0 ||
+        std::fread(written.data(), 1, written.size(), tmp) != written.size() || memcmp(written.data(), pk_bytes.data(), sizeof(Packet)) != 0 ||
+        memcmp(written.data() + sizeof(Packet), tail.data(), tail.size()) != 0 ||
+        memcmp(written.data() + sizeof(Packet) + tail.size(), pk_bytes.data(), sizeof(Packet)) != 0) {
+        std::cerr << "iovec_sink mismatch\n";
+        return -1;
+    }
+    std::fclose(tmp);
+
+    // 批量端序转换与逐个 byteswap 比较
+    std::vector<double> ds(1003);
+    std::vector<int>    is(1003);
+    for (size_t i = 0; i < ds.size(); i++) {
+        ds[i] = i * 1.25;
+        is[i] = static_cast<int>(i * 2654435761u);
+    }
+    std::vector<std::byte> buf(ds.size() * sizeof(double));
+    byteswap_span(std::span<const double>{ds}, buf.data());
+    std::vector<double> ds2(ds.size());
+    byteswap_span(buf.data(), std::span{ds2});
+    auto is2 = is;
+    byteswap_span(std::span{is2});
+    for (size_t i = 0; i < is.size(); i++) {
+        if (ds2[i] != ds[i] || is2[i] != byteswap(is[i]) || brute_byteswap(is[i]) != byteswap(is[i])) {
+            std::cerr << "byteswap_span mismatch at " << i << '\n';
+            return -1;
+        }
+    }
+
+    // varint 与 Stream VByte, 数据大部分很小, 偶尔有大数和负数
+    std::vector<int32_t> small(10007);
+    for (size_t i = 0; i < small.size(); i++) {
+        small[i] = i % 97 == 0 ? static_cast<int32_t>(i * 2654435761u) : static_cast<int32_t>(i % 300) - 150;
+    }
+    std::vector<std::byte> leb, svb;
+    encode_varints(std::span<const int32_t>{small}, leb);
+    streamvbyte_encode(std::span<const int32_t>{small}, svb);
+    std::vector<int32_t> from_leb(small.size()), from_svb(small.size());
+    if (decode_varints(std::span<const std::byte>{leb}, std::span{from_leb}) != leb.size() ||
+        streamvbyte_decode(std::span<const std::byte>{svb}, std::span{from_svb}) != svb.size() || from_leb != small || from_svb != small) {
+        std::cerr << "varint mismatch\n";
+        return -1;
+    }
+    std::cout << "raw " << small.size() * 4 << " bytes, varint " << leb.size() << " bytes, stream vbyte " << svb.size() << " bytes\n";
+
+    // 列式批量序列化: 递增的 id、小范围的数量、价格和枚举
+    enum class Side : uint8_t { Buy, Sell, Cancel };
+    struct Order {
+        int64_t id;
+        double  price;
+        Side    side;
+        bool    operator==(const Order&) const = default;
+    };
+    std::vector<Order> orders(10000);
+    for (size_t i = 0; i < orders.size(); i++) {
+        orders[i] = {static_cast<int64_t>(1'000'000 + i * 3), 100.0 + (i % 64) * 0.25, static_cast<Side>(i % 3)};
+    }
+    const auto cols = serialize_columns(std::span<const Order>{orders});
+    const auto soa  = deserialize_columns_soa<Order>(cols);
+    if (deserialize_columns<Order>(cols) != orders || std::get<0>(soa).size() != orders.size() || std::get<1>(soa)[5] != orders[5].price ||
+        std::get<2>(soa)[7] != orders[7].side) {
+        std::cerr << "columnar mismatch\n";
+        return -1;
+    }
+    std::cout << "per-record " << orders.size() * sizeof(Order) << " bytes, columnar " << cols.size() << " bytes\n";
+
+    // 字符串、容器、optional、map
+    struct Profile {
+        int                 id;
+        std::string         name;
+        std::vector<double> scores;
+        bool                operator==(const Profile&) const = default;
+    };
+    struct Catalog {
+        std::map<std::string, Profile>     by_name;
+        std::optional<std::vector<Person>> people;
+        std::array<std::string, 2>         notes;
+        bool                               operator==(const Catalog&) const = default;
+    };
+    Catalog catalog{{{"alice", {1, "alice", {1.5, 2.5}}}, {"bob", {2, std::string(10000, 'b'), std::vector<double>(1000, 0.5)}}},
+                    std::vector<Person>{p, p},
+                    {"", "note"}};
+    const auto catalog_bytes = serialize(catalog);
+    iovec_sink catalog_iov;
+    serialize_to(catalog_iov, catalog);
+    if (deserialize<Catalog>(catalog_bytes) != catalog || catalog_iov.size() != catalog_bytes.size()) {
+        std::cerr << "container serializer mismatch\n";
+        return -1;
+    }
+    try {
+        deserialize<Catalog>(std::vector<std::byte>(catalog_bytes.begin(), catalog_bytes.begin() + catalog_bytes.size() / 2));
+        std::cerr << "truncated input not detected\n";
+        return -1;
+    } catch (const std::out_of_range&) {
+    }
+
+    // 记录流文件: 后台线程写入, mmap 读回
+    char path[] = "/tmp/serialize2_XXXXXX";
+    ::close(::mkstemp(path));
+    {
+        record_file_writer writer{path, 64 << 10};
+        for (int i = 0; i < 20000; i++) {
+            writer.write(Profile{i, "user" + std::to_string(i), std::vector<double>(i % 8, i * 0.5)});
+        }
+        if (writer.error() != 0) {
+            std::cerr << "record_file_writer error " << writer.error() << '\n';
+            return -1;
+        }
+    }
+    int read_count = 0;
+    for (const auto record : record_file_reader{path}) {
+        const auto profile = deserialize<Profile>(record);
+        if (profile.id != read_count || profile.name != "user" + std::to_string(read_count) || profile.scores.size() != size_t(read_count % 8)) {
+            std::cerr << "record stream mismatch at " << read_count << '\n';
+            return -1;
+        }
+        read_count++;
+    }
+    ::unlink(path);
+    if (read_count != 20000) {
+        std::cerr << "record stream lost records\n";
+        return -1;
+    }
+
+    // flush() 与周期性 fdatasync 并发: 先让同步间隔到期, 写满一块交给后台线程, 让出 CPU 让它写完并开始周期性同步,
+    // 再追加一条并 flush(); flush() 返回时这条记录也必须已经同步
+    ::close(::mkstemp(path));
+    {
+        record_file_writer writer{path, 256, std::chrono::milliseconds{1}};
+        for (int i = 0; i < 100; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{2});
+            for (int j = 0; j < 16; j++) {
+                writer.write(Person{j, j * 0.5, 'x'});
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+            writer.write(Person{i, i * 0.5, 'y'});
+            writer.flush();
+            if (writer.synced_bytes() != writer.appended_bytes()) {
+                std::cerr << "record_file_writer::flush returned before fdatasync at " << i << '\n';
+                return -1;
+            }
+        }
+    }
+    ::unlink(path);
+}
\ No newline at end of file
@@ -1,11 +1,30 @@
 #include <algorithm>
+#include <bit>
+#include <cerrno>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <endian.h>
 #include <execution>
 #include <experimental/bits/simd.h>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <experimental/simd>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #ifndef DEFINES_H
 #define DEFINES_H
 #include <iostream>
@@ -66,8 +85,15 @@ void  to_gray3(ImageSIMD& img) {
 using Pixel32 = uint32_t;
 using Image32 = std::vector<uint32_t>;
 using PixelV  = stdx::native_simd<Pixel32>;
-void to_gray4(Image32& img) { 
-    for (auto it = img.begin(); it < img.end(); it += PixelV::size()) {
+inline Pixel32 gray_pixel32(Pixel32 p) {
+    const Pixel32 gray = ((p >> 16 & 0xFFu) * 11u + (p >> 8 & 0xFFu) * 16u + (p & 0xFFu) * 5u) / 32u;
+    return gray | (gray << 8) | (gray << 16) | (p & 0xFF000000u);
+}
+// span 版本: 可以直接作用在 mmap 出来的像素上, 尾部不足一个 PixelV 的部分走标量
+void to_gray4(std::span<Pixel32> img) {
+    const auto vec_end = img.begin() + img.size() / PixelV::size() * PixelV::size();
+    auto       it      = img.begin();
+    for (; it < vec_end; it += PixelV::size()) {
         PixelV     p(&*it, stdx::element_aligned);
         const auto a     = p >> 24;
         const auto r     = p >> 16 & 0xFFu;
@@ -77,60 +103,735 @@ void to_gray4(Image32& img) {
         p                = grayv | (grayv << 8) | (grayv << 16) | (a << 24);
         p.copy_to(&*it, stdx::element_aligned);
     }
+    for (; it < img.end(); ++it) {
+        *it = gray_pixel32(*it);
+    }
+}
+void to_gray4(Image32& img) { to_gray4(std::span<Pixel32>{img}); }
+
+/*
+图片文件读写: 基于 mmap, 支持
+  - Raw: 无文件头的 BGRA(小端序下即 0xAARRGGBB 的 Pixel32), 可以零拷贝地当作 std::span<Pixel32>
+  - PAM: P7, DEPTH 3/4, MAXVAL 255, 像素按 RGB(A) 字节序存储
+  - PPM: P6, MAXVAL 255, 像素按 RGB 字节序存储
+PAM/PPM 的字节序和 Pixel32 不同, 只能在分块处理时顺便转换
+*/
+enum class ImageFormat { Raw, PAM, PPM };
+
+struct ImageHeader {
+    ImageFormat format;
+    size_t      width;
+    size_t      height;
+    size_t      depth;  //!< 每个像素的字节数
+    size_t      offset; //!< 像素数据相对文件开头的偏移
+};
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& o) noexcept : fd_(std::exchange(o.fd_, -1)), data_(std::exchange(o.data_, nullptr)), size_(std::exchange(o.size_, 0)) {}
+    ~MappedFile() { close(); }
+
+    /**
+     * @brief 只读映射一个已存在的文件
+     */
+    static MappedFile open_read(const char* path) {
+        MappedFile f;
+        f.fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (f.fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        struct stat st {};
+        if (::fstat(f.fd_, &st) < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        f.map(static_cast<size_t>(st.st_size), PROT_READ, path);
+        return f;
+    }
+    /**
+     * @brief 创建(或截断)文件到 size 字节并读写映射, 写入的数据由内核负责回写
+     */
+    static MappedFile create(const char* path, size_t size) {
+        MappedFile f;
+        f.fd_ = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (f.fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        if (::ftruncate(f.fd_, static_cast<off_t>(size)) < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        f.map(size, PROT_READ | PROT_WRITE, path);
+        return f;
+    }
+
+    std::span<std::byte> bytes() const { return {static_cast<std::byte*>(data_), size_}; }
+
+    /**
+     * @brief 对 [offset, offset+len) 调用 madvise, 范围会向外对齐到页
+     */
+    void advise(size_t offset, size_t len, int advice) const {
+        if (data_ == nullptr || offset >= size_) {
+            return;
+        }
+        const size_t page  = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        const size_t begin = offset / page * page;
+        const size_t end   = std::min(offset + len, size_);
+        ::madvise(static_cast<std::byte*>(data_) + begin, end - begin, advice);
+    }
+    /**
+     * @brief 异步地把 [offset, offset+len) 的脏页提交回写, 不等待完成
+     */
+    void flush_async(size_t offset, size_t len) const {
+        if (data_ == nullptr || offset >= size_) {
+            return;
+        }
+        const size_t page  = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        const size_t begin = offset / page * page;
+        const size_t end   = std::min(offset + len, size_);
+        ::msync(static_cast<std::byte*>(data_) + begin, end - begin, MS_ASYNC);
+    }
+
+private:
+    void map(size_t size, int prot, const char* path) {
+        size_ = size;
+        if (size_ == 0) {
+            return;
+        }
+        void* p = ::mmap(nullptr, size_, prot, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        data_ = p;
+    }
+    void close() {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        data_ = nullptr;
+        fd_   = -1;
+    }
+
+    int    fd_   = -1;
+    void*  data_ = nullptr;
+    size_t size_ = 0;
+};
+
+namespace image_io {
+    // 跳过空白和 '#' 注释, 读取下一个 token
+    inline std::string_view next_token(std::string_view s, size_t& pos) {
+        while (pos < s.size()) {
+            if (s[pos] == '#') {
+                while (pos < s.size() && s[pos] != '\n') {
+                    pos++;
+                }
+            } else if (s[pos] == ' ' || s[pos] == '\t' || s[pos] == '\n' || s[pos] == '\r') {
+                pos++;
+            } else {
+                break;
+            }
+        }
+        const size_t begin = pos;
+        while (pos < s.size() && s[pos] != ' ' && s[pos] != '\t' && s[pos] != '\n' && s[pos] != '\r') {
+            pos++;
+        }
+        return s.substr(begin, pos - begin);
+    }
+    inline size_t to_size(std::string_view tok) {
+        size_t v = 0;
+        if (tok.empty()) {
+            throw std::runtime_error("bad image header");
+        }
+        for (char c : tok) {
+            if (c < '0' || c > '9') {
+                throw std::runtime_error("bad image header: " + std::string{tok});
+            }
+            if (__builtin_mul_overflow(v, 10uz, &v) || __builtin_add_overflow(v, static_cast<size_t>(c - '0'), &v)) {
+                throw std::runtime_error("image header value too large: " + std::string{tok});
+            }
+        }
+        return v;
+    }
+} // namespace image_io
+
+/**
+ * @brief 解析文件头; 没有 P6/P7 魔数的文件当作宽度为 raw_width 的 Raw BGRA
+ */
+ImageHeader parse_image_header(std::span<const std::byte> file, size_t raw_width) {
+    using namespace image_io;
+    const std::string_view s{reinterpret_cast<const char*>(file.data()), std::min<size_t>(file.size(), 4096)};
+    size_t                 pos = 0;
+    if (s.starts_with("P6")) {
+        pos = 2;
+        ImageHeader h{.format = ImageFormat::PPM, .width = 0, .height = 0, .depth = 3, .offset = 0};
+        h.width  = to_size(next_token(s, pos));
+        h.height = to_size(next_token(s, pos));
+        if (to_size(next_token(s, pos)) != 255) {
+            throw std::runtime_error("only MAXVAL 255 PPM is supported");
+        }
+        h.offset = pos + 1; // MAXVAL 后面恰好一个空白字符
+        return h;
+    }
+    if (s.starts_with("P7")) {
+        pos = 2;
+        ImageHeader h{.format = ImageFormat::PAM, .width = 0, .height = 0, .depth = 0, .offset = 0};
+        for (auto key = next_token(s, pos); key != "ENDHDR"; key = next_token(s, pos)) {
+            if (key.empty()) {
+                throw std::runtime_error("PAM header without ENDHDR");
+            }
+            const auto value = next_token(s, pos);
+            if (key == "WIDTH") {
+                h.width = to_size(value);
+            } else if (key == "HEIGHT") {
+                h.height = to_size(value);
+            } else if (key == "DEPTH") {
+                h.depth = to_size(value);
+            } else if (key == "MAXVAL" && to_size(value) != 255) {
+                throw std::runtime_error("only MAXVAL 255 PAM is supported");
+            }
+        }
+        if (h.depth != 3 && h.depth != 4) {
+            throw std::runtime_error("only DEPTH 3/4 PAM is supported");
+        }
+        h.offset = pos + 1;
+        return h;
+    }
+    if (raw_width == 0 || raw_width > file.size() / 4 || file.size() % (raw_width * 4) != 0) {
+        throw std::runtime_error("raw BGRA file size is not a multiple of width * 4");
+    }
+    return {.format = ImageFormat::Raw, .width = raw_width, .height = file.size() / (raw_width * 4), .depth = 4, .offset = 0};
+}
+
+std::string make_image_header(ImageFormat format, size_t width, size_t height) {
+    switch (format) {
+    case ImageFormat::PAM:
+        return "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height) + "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    case ImageFormat::PPM:
+        return "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    case ImageFormat::Raw:
+        break;
+    }
+    return {};
+}
+
+/**
+ * @brief Raw 文件零拷贝地视作像素; 文件是 MAP_SHARED 的, 修改会直接写回文件
+ */
+std::span<Pixel32> as_pixels(const MappedFile& file) {
+    auto bytes = file.bytes();
+    return {reinterpret_cast<Pixel32*>(bytes.data()), bytes.size() / sizeof(Pixel32)};
+}
+
+// 把 RGB(A) 字节流解码成 Pixel32, 以及反向编码
+void decode_pixels(const ImageHeader& h, const std::byte* src, std::span<Pixel32> dst) {
+    const auto* s = reinterpret_cast<const uint8_t*>(src);
+    if (h.format == ImageFormat::Raw) {
+        std::memcpy(dst.data(), s, dst.size_bytes());
+        return;
+    }
+    for (auto& p : dst) {
+        const uint32_t a = h.depth == 4 ? s[3] : 0xFFu;
+        p                = a << 24 | uint32_t{s[0]} << 16 | uint32_t{s[1]} << 8 | s[2];
+        s += h.depth;
+    }
+}
+void encode_pixels(ImageFormat format, std::span<const Pixel32> src, std::byte* dst) {
+    auto* d = reinterpret_cast<uint8_t*>(dst);
+    if (format == ImageFormat::Raw) {
+        std::memcpy(d, src.data(), src.size_bytes());
+        return;
+    }
+    const size_t depth = format == ImageFormat::PAM ? 4 : 3;
+    for (const auto p : src) {
+        d[0] = p >> 16 & 0xFFu;
+        d[1] = p >> 8 & 0xFFu;
+        d[2] = p & 0xFFu;
+        if (depth == 4) {
+            d[3] = p >> 24;
+        }
+        d += depth;
+    }
+}
+
+/**
+ * @brief 分块流式处理: 输入输出都 mmap, 每块先 MADV_WILLNEED 预读下一块,
+ * 处理完的输出块 MS_ASYNC 提交回写、输入块 MADV_DONTNEED 释放页缓存,
+ * 这样内核的读写与 kernel 的计算互相重叠, 吞吐受限于磁盘而不是 CPU
+ *
+ * 输出为 Raw 时直接在输出映射上计算, 不需要中间缓冲
+ *
+ * @param kernel       形如 void(std::span<Pixel32>) 的图像处理函数, 例如 to_gray4
+ * @param chunk_pixels 每块像素数, 默认 4MiB
+ */
+template <typename Kernel>
+void stream_image(const char* in_path, const char* out_path, ImageFormat out_format, Kernel&& kernel, size_t raw_width = 0,
+                  size_t chunk_pixels = 1uz << 20) {
+    const auto in        = MappedFile::open_read(in_path);
+    const auto header    = parse_image_header(in.bytes(), raw_width);
+    const auto prefix    = make_image_header(out_format, header.width, header.height);
+    const auto out_depth = out_format == ImageFormat::PPM ? 3uz : 4uz;
+    // 尺寸来自文件头, 乘加都要检查溢出, 否则回绕后能通过长度检查, 越界读映射
+    size_t pixels = 0, in_bytes = 0, in_end = 0, out_bytes = 0, out_size = 0;
+    if (__builtin_mul_overflow(header.width, header.height, &pixels) || __builtin_mul_overflow(pixels, header.depth, &in_bytes) ||
+        __builtin_add_overflow(header.offset, in_bytes, &in_end) || __builtin_mul_overflow(pixels, out_depth, &out_bytes) ||
+        __builtin_add_overflow(prefix.size(), out_bytes, &out_size)) {
+        throw std::runtime_error("image dimensions overflow");
+    }
+    if (in.bytes().size() < in_end) {
+        throw std::runtime_error("truncated image file");
+    }
+    auto out = MappedFile::create(out_path, out_size);
+    std::memcpy(out.bytes().data(), prefix.data(), prefix.size());
+
+    in.advise(0, in.bytes().size(), MADV_SEQUENTIAL);
+    Image32 staging(out_format == ImageFormat::Raw ? 0 : std::min(chunk_pixels, pixels));
+    for (size_t first = 0; first < pixels; first += chunk_pixels) {
+        const size_t count   = std::min(chunk_pixels, pixels - first);
+        const size_t in_off  = header.offset + first * header.depth;
+        const size_t out_off = prefix.size() + first * out_depth;
+        in.advise(in_off + count * header.depth, chunk_pixels * header.depth, MADV_WILLNEED);
+
+        std::span<Pixel32> work = out_format == ImageFormat::Raw ? as_pixels(out).subspan(first, count) : std::span<Pixel32>{staging}.first(count);
+        decode_pixels(header, in.bytes().data() + in_off, work);
+        kernel(work);
+        if (out_format != ImageFormat::Raw) {
+            encode_pixels(out_format, work, out.bytes().data() + out_off);
+        }
+
+        out.flush_async(out_off, count * out_depth);
+        in.advise(in_off, count * header.depth, MADV_DONTNEED);
+    }
+}
+
+/*
+alpha 合成: 预乘/反预乘, Porter-Duff over 和普通 alpha 混合
+一个 Pixel32 拆成 0x00RR00BB 和 0x00AA00GG 两半, 每个通道占 16 位, 一次乘法同时算两个通道(SWAR),
+x / 255 用 (t + (t >> 8)) >> 8, t = x + 128 精确舍入, 对 x <= 255 * 255 与 (x + 127) / 255 完全相同
+同一份模板代码既用于 PixelV 也用于尾部的 Pixel32, 因此 SIMD 结果与标量参考逐位一致
+*/
+template <typename V>
+inline V div255_x2(V x) {
+    x += 0x00800080u;
+    return (x + (x >> 8 & 0x00FF00FFu)) >> 8 & 0x00FF00FFu;
+}
+// 每个 16 位通道饱和到 255 (输入每个通道 <= 510)
+template <typename V>
+inline V saturate_x2(V x) {
+    return (x | (x >> 8 & 0x00010001u) * 0xFFu) & 0x00FF00FFu;
+}
+
+template <typename V>
+inline V premultiply_px(V p) {
+    const V a  = p >> 24;
+    const V rb = div255_x2((p & 0x00FF00FFu) * a);
+    const V g  = div255_x2((p >> 8 & 0xFFu) * a);
+    return rb | g << 8 | a << 24;
+}
+// src 为预乘 alpha: dst = src + dst * (255 - src.a) / 255
+template <typename V>
+inline V over_px(V dst, V src) {
+    const V inv = 255u - (src >> 24);
+    const V rb  = saturate_x2((src & 0x00FF00FFu) + div255_x2((dst & 0x00FF00FFu) * inv));
+    const V ag  = saturate_x2((src >> 8 & 0x00FF00FFu) + div255_x2((dst >> 8 & 0x00FF00FFu) * inv));
+    return rb | ag << 8;
+}
+// 非预乘 alpha, 覆盖层整体再乘 opacity: a = src.a * opacity / 255,
+// rgb = (src * a + dst * (255 - a)) / 255, alpha = a + dst.a * (255 - a) / 255
+template <typename V>
+inline V blend_px(V dst, V src, uint32_t opacity) {
+    const V a   = div255_x2((src >> 24) * opacity);
+    const V inv = 255u - a;
+    const V rb  = div255_x2((src & 0x00FF00FFu) * a + (dst & 0x00FF00FFu) * inv);
+    const V g   = div255_x2((src >> 8 & 0xFFu) * a + (dst >> 8 & 0xFFu) * inv);
+    const V oa  = a + div255_x2((dst >> 24) * inv);
+    return rb | g << 8 | oa << 24;
+}
+// 反预乘需要除以 alpha, 用 float 除法后截断: 分子 < 2^16, 分母 < 2^8, 结果与整数除法完全一致
+inline Pixel32 unpremultiply_px(Pixel32 p) {
+    const uint32_t a = p >> 24;
+    if (a == 0) {
+        return 0;
+    }
+    const auto ch = [a](uint32_t c) { return std::min(255u, (c * 255u + a / 2) / a); };
+    return ch(p & 0xFFu) | ch(p >> 8 & 0xFFu) << 8 | ch(p >> 16 & 0xFFu) << 16 | a << 24;
+}
+using PixelFV = stdx::rebind_simd_t<float, PixelV>;
+inline PixelV unpremultiply_px(PixelV p) {
+    const PixelV a    = p >> 24;
+    const auto   zero = a == 0u;
+    PixelV       d    = a;
+    stdx::where(zero, d) = 1u;
+    const PixelFV af     = stdx::static_simd_cast<PixelFV>(d);
+    const auto    ch     = [&](PixelV c) {
+        const PixelFV q = stdx::static_simd_cast<PixelFV>(c * 255u + (a >> 1)) / af;
+        return stdx::min(stdx::static_simd_cast<PixelV>(q), PixelV(255u));
+    };
+    PixelV res = ch(p & 0xFFu) | ch(p >> 8 & 0xFFu) << 8 | ch(p >> 16 & 0xFFu) << 16 | a << 24;
+    stdx::where(zero, res) = 0u;
+    return res;
+}
+
+/**
+ * @brief 对 dst[i] = op(dst[i], src[i]) 做 SIMD 循环, 尾部走 Pixel32 版本
+ */
+template <typename Op>
+void simd_pixels(std::span<Pixel32> dst, std::span<const Pixel32> src, Op&& op) {
+    size_t i = 0;
+    for (; i + PixelV::size() <= dst.size(); i += PixelV::size()) {
+        const PixelV d(&dst[i], stdx::element_aligned);
+        const PixelV s(&src[i], stdx::element_aligned);
+        op(d, s).copy_to(&dst[i], stdx::element_aligned);
+    }
+    for (; i < dst.size(); ++i) {
+        dst[i] = op(dst[i], src[i]);
+    }
+}
+/**
+ * @brief 按块切分后用 std::execution::par 多线程执行 simd_pixels
+ */
+template <typename Op>
+void parallel_pixels(std::span<Pixel32> dst, std::span<const Pixel32> src, Op&& op, size_t block = 1uz << 16) {
+    std::vector<size_t> firsts;
+    for (size_t first = 0; first < dst.size(); first += block) {
+        firsts.push_back(first);
+    }
+    std::for_each(std::execution::par, firsts.begin(), firsts.end(), [&](size_t first) {
+        const size_t count = std::min(block, dst.size() - first);
+        simd_pixels(dst.subspan(first, count), src.subspan(first, count), op);
+    });
 }
 
-int main() {
-    Image img{};
-    img.reserve(4096uz * 4096);
-    //随机生成图片
-    for (int i = 0; i < img.capacity(); i++) {
-        img.emplace_back(std::rand());
-    }
-    auto      img2 = img;
-    ImageSIMD img3{};
-    img3.reserve(img.size());
-    for (const auto& i : img) {
-        stdx::fixed_size_simd<uint8_t, 4> tmp{reinterpret_cast<const uint8_t*>(&i), stdx::element_aligned};
-        img3.push_back(std::move(tmp));
-    }
-    Image32 img4{};
-    img4.reserve(img.size());
-    for (auto const& i : img) {
-        img4.push_back(*reinterpret_cast<const uint32_t*>(&i)); // 小端序的问题，这里是0XAARRGGBB,
-    }
-    Tick;
-    to_gray1(img);
-    Tock;
-    ReTick;
-    to_gray2(img2);
-    Tock;
-    // 检查 to_gray2 实现是否正确
-    // for (int i = 0; i < img.size(); i++) {
-    //     if (img[i] != img2[i]) {
-    //         std::cerr << "dismatch on img2, index is " << i << std::endl;
-    //         return -1;
-    //     }
-    // }
-    ReTick;
-    to_gray3(img3);
-    Tock;
-    // 检查 to_gray3 实现是否正确
-    // for (int i = 0; i < img.size(); i++) {
-    //     stdx::fixed_size_simd<uint8_t, 4> tmp{reinterpret_cast<const uint8_t*>(&img[i]), stdx::element_aligned};
-    //     if (!stdx::all_of(tmp == img3[i])) {
-    //         std::cerr << "dismatch on img3, index is " << i << std::endl;
-    //         return -1;
-    //     }
-    // }
-    ReTick;
-    to_gray4(img4);
-    Tock;
-    // 检查 to_gray4 实现是否正确
-    // for (int i = 0; i < img.size(); i++) {
-    //     Pixel p{img4[i]};
-    //     if (img[i] != p) {
-    //         std::cerr << "dismatch on img4, index is " << i << std::endl;
-    //         return -1;
-    //     }
-    // }
-}
\ No newline at end of file
+void premultiply(std::span<Pixel32> img) {
+    parallel_pixels(img, img, [](auto p, auto) { return premultiply_px(p); });
+}
+void unpremultiply(std::span<Pixel32> img) {
+    parallel_pixels(img, img, [](auto p, auto) { return unpremultiply_px(p); });
+}
+/**
+ * @brief Porter-Duff over, src 与 dst 都是预乘 alpha
+ */
+void composite_over(std::span<Pixel32> dst, std::span<const Pixel32> src) {
+    parallel_pixels(dst, src, [](auto d, auto s) { return over_px(d, s); });
+}
+/**
+ * @brief 非预乘的 alpha 混合, opacity 为覆盖层整体不透明度
+ */
+void alpha_blend(std::span<Pixel32> dst, std::span<const Pixel32> src, uint8_t opacity = 255) {
+    parallel_pixels(dst, src, [opacity](auto d, auto s) { return blend_px(d, s, opacity); });
+}
+
+// 逐通道的标量参考实现, 用于校验上面的 SIMD 版本
+namespace ref {
+    inline uint32_t mul255(uint32_t x) { return (x + 127) / 255; }
+    inline Pixel32  pack(Pixel p) { return std::bit_cast<Pixel32>(p); }
+
+    void premultiply(Image32& img) {
+        for (auto& v : img) {
+            Pixel p{v};
+            p.b = mul255(p.b * p.a);
+            p.g = mul255(p.g * p.a);
+            p.r = mul255(p.r * p.a);
+            v   = pack(p);
+        }
+    }
+    void unpremultiply(Image32& img) {
+        for (auto& v : img) {
+            Pixel p{v};
+            if (p.a == 0) {
+                v = 0;
+                continue;
+            }
+            for (uint8_t* c : {&p.b, &p.g, &p.r}) {
+                *c = std::min(255, (*c * 255 + p.a / 2) / p.a);
+            }
+            v = pack(p);
+        }
+    }
+    void composite_over(Image32& dst, const Image32& src) {
+        for (size_t i = 0; i < dst.size(); i++) {
+            Pixel       d{dst[i]};
+            const Pixel s{src[i]};
+            const auto  inv = 255u - s.a;
+            d.b             = std::min(255u, s.b + mul255(d.b * inv));
+            d.g             = std::min(255u, s.g + mul255(d.g * inv));
+            d.r             = std::min(255u, s.r + mul255(d.r * inv));
+            d.a             = std::min(255u, s.a + mul255(d.a * inv));
+            dst[i]          = pack(d);
+        }
+    }
+    void alpha_blend(Image32& dst, const Image32& src, uint8_t opacity = 255) {
+        for (size_t i = 0; i < dst.size(); i++) {
+            Pixel       d{dst[i]};
+            const Pixel s{src[i]};
+            const auto  a   = mul255(s.a * opacity);
+            const auto  inv = 255u - a;
+            d.b             = mul255(s.b * a + d.b * inv);
+            d.g             = mul255(s.g * a + d.g * inv);
+            d.r             = mul255(s.r * a + d.r * inv);
+            d.a             = a + mul255(d.a * inv);
+            dst[i]          = pack(d);
+        }
+    }
+} // namespace ref
+
+/*
+kernel 测试框架: 注册所有图像 kernel, 每个 kernel 先与标量参考逐位比较,
+再在多个尺寸(缓存内/缓存外)上预热 + 多次计时, 报告 GPix/s、bytes/cycle 和 perf_event 计数
+*/
+namespace bench {
+    Image to_image(const Image32& img) {
+        Image res;
+        res.reserve(img.size());
+        for (auto v : img) {
+            res.emplace_back(v);
+        }
+        return res;
+    }
+    Image32 from_image(const Image& img) {
+        Image32 res;
+        res.reserve(img.size());
+        for (const auto& p : img) {
+            res.push_back(std::bit_cast<Pixel32>(p));
+        }
+        return res;
+    }
+    ImageSIMD to_image_simd(const Image32& img) {
+        ImageSIMD res;
+        res.reserve(img.size());
+        for (const auto& v : img) {
+            res.emplace_back(reinterpret_cast<const uint8_t*>(&v), stdx::element_aligned);
+        }
+        return res;
+    }
+    Image32 from_image(const ImageSIMD& img) {
+        Image32 res(img.size());
+        for (size_t i = 0; i < img.size(); i++) {
+            img[i].copy_to(reinterpret_cast<uint8_t*>(&res[i]), stdx::element_aligned);
+        }
+        return res;
+    }
+
+    /**
+     * @brief 一次测量的实例: reset 不计时, run 计时, result 转回 Image32 用于比较
+     */
+    struct KernelRun {
+        virtual ~KernelRun()     = default;
+        virtual void    reset()  = 0;
+        virtual void    run()    = 0;
+        virtual Image32 result() = 0;
+    };
+
+    template <typename Img, typename Fn>
+    struct KernelRunOf : KernelRun {
+        KernelRunOf(Img input, Image32 overlay, Fn fn) : input(std::move(input)), img(this->input), overlay(std::move(overlay)), fn(fn) {}
+        void    reset() override { std::copy(input.begin(), input.end(), img.begin()); }
+        void    run() override { fn(img, overlay); }
+        Image32 result() override {
+            if constexpr (std::is_same_v<Img, Image32>) {
+                return img;
+            } else {
+                return from_image(img);
+            }
+        }
+        Img     input, img;
+        Image32 overlay;
+        Fn      fn;
+    };
+
+    struct ImageKernel {
+        std::string name;
+        size_t      bytes_per_pixel; //!< 每像素读写的内存字节数
+        //! 标量参考实现
+        std::function<void(Image32& frame, const Image32& overlay)> reference;
+        //! 从输入准备一次测量
+        std::function<std::unique_ptr<KernelRun>(const Image32& frame, const Image32& overlay)> prepare;
+    };
+
+    template <typename Fn>
+    std::unique_ptr<KernelRun> make_run(Image frame, Image32 overlay, Fn fn) {
+        return std::make_unique<KernelRunOf<Image, Fn>>(std::move(frame), std::move(overlay), fn);
+    }
+    template <typename Fn>
+    std::unique_ptr<KernelRun> make_run(ImageSIMD frame, Image32 overlay, Fn fn) {
+        return std::make_unique<KernelRunOf<ImageSIMD, Fn>>(std::move(frame), std::move(overlay), fn);
+    }
+    template <typename Fn>
+    std::unique_ptr<KernelRun> make_run(Image32 frame, Image32 overlay, Fn fn) {
+        return std::make_unique<KernelRunOf<Image32, Fn>>(std::move(frame), std::move(overlay), fn);
+    }
+
+    /**
+     * @brief 所有参与测试的 kernel; 新增 kernel 时在这里注册
+     */
+    std::vector<ImageKernel> image_kernels() {
+        const auto gray_ref = [](Image32& f, const Image32&) {
+            auto img = to_image(f);
+            to_gray1(img);
+            f = from_image(img);
+        };
+        return {
+            {"to_gray1", 8, gray_ref,
+             [](const Image32& f, const Image32& o) { return make_run(to_image(f), o, [](Image& img, const Image32&) { to_gray1(img); }); }},
+            {"to_gray2", 8, gray_ref,
+             [](const Image32& f, const Image32& o) { return make_run(to_image(f), o, [](Image& img, const Image32&) { to_gray2(img); }); }},
+            {"to_gray3", 8, gray_ref,
+             [](const Image32& f, const Image32& o) { return make_run(to_image_simd(f), o, [](ImageSIMD& img, const Image32&) { to_gray3(img); }); }},
+            {"to_gray4", 8, gray_ref,
+             [](const Image32& f, const Image32& o) { return make_run(f, o, [](Image32& img, const Image32&) { to_gray4(img); }); }},
+            {"premultiply", 8, [](Image32& f, const Image32&) { ref::premultiply(f); },
+             [](const Image32& f, const Image32& o) { return make_run(f, o, [](Image32& img, const Image32&) { premultiply(img); }); }},
+            {"unpremultiply", 8, [](Image32& f, const Image32&) { ref::unpremultiply(f); },
+             [](const Image32& f, const Image32& o) { return make_run(f, o, [](Image32& img, const Image32&) { unpremultiply(img); }); }},
+            {"composite_over", 12, [](Image32& f, const Image32& o) { ref::composite_over(f, o); },
+             [](const Image32& f, const Image32& o) { return make_run(f, o, [](Image32& img, const Image32& ov) { composite_over(img, ov); }); }},
+            {"alpha_blend", 12, [](Image32& f, const Image32& o) { ref::alpha_blend(f, o, 200); },
+             [](const Image32& f, const Image32& o) { return make_run(f, o, [](Image32& img, const Image32& ov) { alpha_blend(img, ov, 200); }); }},
+        };
+    }
+
+    /**
+     * @brief perf_event 计数器: cycles、instructions、LLC misses
+     * 计数器以 inherit 方式打开且一直运行, 每次测量取前后差值;
+     * 读取时内核会把仍存活的子线程(std::execution::par 的线程池)计数一并加上,
+     * 所以应在第一次调用并行算法之前构造
+     */
+    class PerfCounters {
+    public:
+        struct Sample {
+            uint64_t cycles, instructions, llc_misses;
+        };
+        PerfCounters() {
+            const uint64_t configs[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+            for (int i = 0; i < 3; i++) {
+                perf_event_attr attr{};
+                attr.type           = PERF_TYPE_HARDWARE;
+                attr.size           = sizeof(attr);
+                attr.config         = configs[i];
+                attr.inherit        = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv     = 1;
+                fds_[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+        }
+        PerfCounters(const PerfCounters&)            = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+        ~PerfCounters() {
+            for (int fd : fds_) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+        }
+        //! 没有权限(perf_event_paranoid)或在虚拟机里时为 false
+        bool   valid() const { return fds_[0] >= 0; }
+        Sample read() const {
+            uint64_t v[3]{};
+            for (int i = 0; i < 3; i++) {
+                if (fds_[i] >= 0 && ::read(fds_[i], &v[i], sizeof(v[i])) != sizeof(v[i])) {
+                    v[i] = 0;
+                }
+            }
+            return {v[0], v[1], v[2]};
+        }
+
+    private:
+        int fds_[3]{-1, -1, -1};
+    };
+
+    struct Result {
+        double                seconds; //!< 中位数
+        double                best;
+        PerfCounters::Sample counters; //!< 中位数那一次的计数
+    };
+
+    Result measure(KernelRun& run, const PerfCounters& perf, int warmup, int trials) {
+        for (int i = 0; i < warmup; i++) {
+            run.reset();
+            run.run();
+        }
+        std::vector<std::pair<double, PerfCounters::Sample>> samples;
+        for (int i = 0; i < trials; i++) {
+            run.reset();
+            const auto c0 = perf.read();
+            const auto t0 = std::chrono::steady_clock::now();
+            run.run();
+            const auto t1 = std::chrono::steady_clock::now();
+            const auto c1 = perf.read();
+            samples.push_back({std::chrono::duration<double>(t1 - t0).count(),
+                               {c1.cycles - c0.cycles, c1.instructions - c0.instructions, c1.llc_misses - c0.llc_misses}});
+        }
+        std::ranges::sort(samples, {}, &decltype(samples)::value_type::first);
+        const auto& mid = samples[samples.size() / 2];
+        return {mid.first, samples.front().first, mid.second};
+    }
+
+    Image32 random_image(size_t n) {
+        Image32 img(n);
+        for (auto& v : img) {
+            v = uint32_t(std::rand()) << 1 ^ std::rand();
+        }
+        return img;
+    }
+
+    /**
+     * @brief 运行所有 kernel, 校验失败返回 false
+     */
+    bool run_all(int warmup = 2, int trials = 7) {
+        const PerfCounters perf;
+        if (!perf.valid()) {
+            std::cout << "perf_event unavailable, counters are reported as 0" << std::endl;
+        }
+        const auto kernels = image_kernels();
+        bool       ok      = true;
+        // 256x256 在 L2 内, 1024x1024 在 LLC 附近, 4096x4096 远大于 LLC; 宽度取奇数以覆盖 SIMD 尾部
+        for (const size_t side : {255uz, 1023uz, 4095uz}) {
+            const size_t pixels  = side * side;
+            const auto   frame   = random_image(pixels);
+            const auto   overlay = random_image(pixels);
+            std::printf("\n%zux%zu (%.1f MiB)\n%-16s %10s %10s %10s %12s %10s %12s %12s\n", side, side, pixels * 4.0 / (1 << 20), "kernel", "median",
+                        "best", "GPix/s", "bytes/cycle", "IPC", "LLC miss", "check");
+            for (const auto& k : kernels) {
+                Image32 expect = frame;
+                k.reference(expect, overlay);
+                auto run = k.prepare(frame, overlay);
+                run->reset();
+                run->run();
+                const auto got     = run->result();
+                const auto diff    = std::ranges::mismatch(got, expect).in1;
+                const bool matched = diff == got.end();
+                ok                 = ok && matched;
+
+                const auto  r = measure(*run, perf, warmup, trials);
+                const auto& c = r.counters;
+                std::printf("%-16s %8.3fms %8.3fms %10.3f %12.3f %10.2f %12llu %12s\n", k.name.c_str(), r.seconds * 1e3, r.best * 1e3,
+                            pixels / r.seconds * 1e-9, c.cycles ? double(pixels * k.bytes_per_pixel) / c.cycles : 0.0,
+                            c.cycles ? double(c.instructions) / c.cycles : 0.0, static_cast<unsigned long long>(c.llc_misses),
+                            matched ? "ok" : ("diff@" + std::to_string(diff - got.begin())).c_str());
+            }
+        }
+        return ok;
+    }
+} // namespace bench
+
+int main(int argc, char** argv) {
+    // simd_test <输入> <输出> [raw|pam|ppm] [raw 输入的宽度]: 对图片文件流式执行 to_gray4
+    if (argc >= 3) {
+        const std::string_view fmt        = argc >= 4 ? argv[3] : "pam";
+        const ImageFormat      out_format = fmt == "raw" ? ImageFormat::Raw : fmt == "ppm" ? ImageFormat::PPM : ImageFormat::PAM;
+        try {
+            Tick;
+            stream_image(argv[1], argv[2], out_format, [](std::span<Pixel32> px) { to_gray4(px); }, argc >= 5 ? std::stoul(argv[4]) : 0);
+            Tock;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+    // 不带参数时运行 kernel 测试, 有 kernel 与参考实现不一致则返回 -1
+    return bench::run_all() ? 0 : -1;
+}